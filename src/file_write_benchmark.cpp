@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <filesystem>
 
+#include "pgm8.hpp"
 #include "primitives.hpp"
 #include "scoped_timer.hpp"
 
@@ -75,4 +76,72 @@ int main() {
     close(fd);
     std::filesystem::remove("linux_write.bin");
   }
+
+  // PGM images, through pgm8 and the way pgm8 used to do plain images, a stream
+  // call per pixel
+  pgm8::image_properties props;
+  props.set_width(u32(width));
+  props.set_height(u32(height));
+  props.set_maxval(255);
+
+  for (pgm8::format const fmt : { pgm8::format::RAW, pgm8::format::PLAIN }) {
+    props.set_format(fmt);
+    std::string const fmt_name = fmt == pgm8::format::RAW ? "raw" : "plain";
+    std::string const path = "pgm8_" + fmt_name + ".pgm";
+
+    {
+      std::fstream file(path, std::ios::binary | std::ios::out);
+      assert(file);
+      std::string const label = "pgm8::write " + fmt_name;
+      scoped_timer<scoped_timer_unit::MILLISECONDS> timer(label.c_str(), std::cout);
+      assert(pgm8::write(file, props, pixels.data()));
+    }
+
+    std::cout << "  (" << std::filesystem::file_size(path) / (1024 * 1024) << " MiB)\n";
+
+    {
+      std::vector<u8> read(num_pixels);
+      std::ifstream file(path, std::ios::binary);
+      std::string const label = "pgm8::read_pixels " + fmt_name;
+      scoped_timer<scoped_timer_unit::MILLISECONDS> timer(label.c_str(), std::cout);
+      pgm8::image_properties const read_props = pgm8::read_properties(file);
+      pgm8::read_pixels(file, read_props, read.data());
+      assert(read == pixels);
+    }
+
+    std::filesystem::remove(path);
+  }
+
+  {
+    std::fstream file("per_pixel_plain.pgm", std::ios::binary | std::ios::out);
+    assert(file);
+    {
+      scoped_timer<scoped_timer_unit::MILLISECONDS> timer("per pixel plain write", std::cout);
+      file << "P2\n" << width << ' ' << height << "\n255\n";
+      for (u64 r = 0; r < height; ++r) {
+        for (u64 c = 0; c < width; ++c)
+          file << std::to_string(pixels[(r * width) + c]) << ' ';
+        file << '\n';
+      }
+    }
+    file.close();
+
+    {
+      std::vector<u8> read(num_pixels);
+      std::ifstream in("per_pixel_plain.pgm", std::ios::binary);
+      scoped_timer<scoped_timer_unit::MILLISECONDS> timer("per pixel plain read", std::cout);
+      std::string magic_num{};
+      u64 w, h;
+      int maxval;
+      in >> magic_num >> w >> h >> maxval;
+      char pixel[4] {};
+      for (u64 i = 0; i < num_pixels; ++i) {
+        in >> pixel;
+        read[i] = static_cast<u8>(std::stoul(pixel));
+      }
+      assert(read == pixels);
+    }
+
+    std::filesystem::remove("per_pixel_plain.pgm");
+  }
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "primitives.hpp"
+#include "simulation.hpp"
+#include "util.hpp"
+
+// Compares how fast the step kernels go through row by row (dense) and tiled
+// grids, for a few ants which get around differently, across grid sizes. With
+// --huge_pages, compares dense grids backed by regular, transparent huge and
+// hugetlbfs pages instead.
+//
+// usage: layout_benchmark [--huge_pages] [generations] [grid sizes...]
+//
+// Each ant starts facing north in the middle of a grid of shade 0 and runs for
+// `generations` or until it hits the edge. Grids are square and allocated
+// one at a time, so the largest one has to fit in memory (65535^2 is 4 GiB).
+// Hugetlbfs pages have to be reserved beforehand (vm.nr_hugepages), without
+// enough of them grids fall back to transparent huge pages, which is marked.
+
+struct ruleset
+{
+  char const *name;
+  char const *turns; // turn for shade 0, 1, ..., each replaced with the next
+};
+
+static
+simulation::state make_state(
+  i32 const grid_dim,
+  ruleset const &rs,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages)
+{
+  simulation::state state{};
+  state.grid_width = grid_dim;
+  state.grid_height = grid_dim;
+  state.ant_col = grid_dim / 2;
+  state.ant_row = grid_dim / 2;
+  state.ant_orientation = simulation::orientation::NORTH;
+  state.last_step_res = simulation::step_result::NIL;
+
+  u32 const num_rules = u32(std::string(rs.turns).size());
+  for (u32 shade = 0; shade < num_rules; ++shade)
+    state.rules[shade] = { u8((shade + 1) % num_rules), simulation::turn_direction::from_char(rs.turns[shade]) };
+
+  if (!simulation::allocate_grid(state, layout, pages)) {
+    std::fprintf(stderr, "unable to allocate %dx%d grid\n", grid_dim, grid_dim);
+    std::exit(1);
+  }
+  simulation::fill_grid(state, 0);
+
+  return state;
+}
+
+// Returns Mgens/s, how many generations were completed in `gens_completed` and
+// the pages the grid got in `pages_got`.
+static
+f64 measure(
+  i32 const grid_dim,
+  ruleset const &rs,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  u64 const max_gens,
+  u64 &gens_completed,
+  simulation::huge_pages &pages_got)
+{
+  simulation::state state = make_state(grid_dim, rs, layout, pages);
+  pages_got = state.grid_pages;
+  simulation::step_kernel const kernel = simulation::select_step_kernel(state);
+
+  util::time_point_t const start = util::current_time();
+  gens_completed = simulation::step_forward(state, kernel, max_gens);
+  u64 const nanos = util::nanos_between(start, util::current_time());
+
+  simulation::free_grid(state);
+
+  return (f64(gens_completed) / 1'000'000.0) / (f64(std::max(nanos, u64(1))) / 1'000'000'000.0);
+}
+
+static
+char const *pages_cstr(simulation::huge_pages const pages)
+{
+  switch (pages) {
+    case simulation::huge_pages::THP:     return "thp";
+    case simulation::huge_pages::HUGETLB: return "hugetlb";
+    case simulation::huge_pages::OFF:
+    default:                              return "off";
+  }
+}
+
+static ruleset const s_rulesets[] {
+  { "LR",           "LR" },           // builds a diagonal highway
+  { "LLRR",         "LLRR" },         // grows a symmetric blob
+  { "RRLLLRLLLRRR", "RRLLLRLLLRRR" }, // fills a growing triangle
+};
+
+static
+void compare_layouts(std::vector<i32> const &grid_dims, u64 const max_gens)
+{
+  simulation::huge_pages got;
+
+  std::printf("%-12s %-14s %12s %12s %12s %8s\n", "grid", "rules", "generations", "dense", "tiled", "ratio");
+
+  for (i32 const grid_dim : grid_dims) {
+    for (auto const &rs : s_rulesets) {
+      u64 dense_gens, tiled_gens;
+      f64 const dense = measure(grid_dim, rs, simulation::grid_layout::DENSE, simulation::huge_pages::OFF, max_gens, dense_gens, got);
+      f64 const tiled = measure(grid_dim, rs, simulation::grid_layout::TILED, simulation::huge_pages::OFF, max_gens, tiled_gens, got);
+
+      std::string const grid = std::to_string(grid_dim) + "^2";
+      std::printf("%-12s %-14s %12zu %7.2f Mg/s %7.2f Mg/s %7.2fx\n",
+        grid.c_str(), rs.name, dense_gens, dense, tiled, tiled / dense);
+    }
+  }
+}
+
+static
+void compare_huge_pages(std::vector<i32> const &grid_dims, u64 const max_gens)
+{
+  simulation::huge_pages const all_pages[] {
+    simulation::huge_pages::OFF,
+    simulation::huge_pages::THP,
+    simulation::huge_pages::HUGETLB,
+  };
+
+  std::printf("%-12s %-14s %12s %18s %18s %18s %8s %8s\n",
+    "grid", "rules", "generations", "off", "thp", "hugetlb", "thp", "hugetlb");
+
+  for (i32 const grid_dim : grid_dims) {
+    for (auto const &rs : s_rulesets) {
+      f64 mgens[3];
+      u64 gens[3];
+      simulation::huge_pages got[3];
+      for (u64 i = 0; i < 3; ++i)
+        mgens[i] = measure(grid_dim, rs, simulation::grid_layout::DENSE, all_pages[i], max_gens, gens[i], got[i]);
+
+      // falling short of what was asked for, says what was given instead
+      std::string cols[3];
+      for (u64 i = 0; i < 3; ++i) {
+        char col[32];
+        if (got[i] == all_pages[i])
+          std::snprintf(col, sizeof(col), "%7.2f Mg/s", mgens[i]);
+        else
+          std::snprintf(col, sizeof(col), "%7.2f Mg/s (%s)", mgens[i], pages_cstr(got[i]));
+        cols[i] = col;
+      }
+
+      std::string const grid = std::to_string(grid_dim) + "^2";
+      std::printf("%-12s %-14s %12zu %18s %18s %18s %7.2fx %7.2fx\n",
+        grid.c_str(), rs.name, gens[0], cols[0].c_str(), cols[1].c_str(), cols[2].c_str(),
+        mgens[1] / mgens[0], mgens[2] / mgens[0]);
+    }
+  }
+}
+
+int main(int const argc, char const *const *const argv)
+{
+  b8 const huge_pages = argc > 1 && std::strcmp(argv[1], "--huge_pages") == 0;
+  int const first_arg = huge_pages ? 2 : 1;
+
+  u64 const max_gens = argc > first_arg ? std::strtoull(argv[first_arg], nullptr, 10) : 200'000'000;
+
+  std::vector<i32> grid_dims{};
+  for (int i = first_arg + 1; i < argc; ++i)
+    grid_dims.push_back(std::atoi(argv[i]));
+
+  if (huge_pages) {
+    if (grid_dims.empty())
+      grid_dims = { 8192, 16384, 65535 };
+    compare_huge_pages(grid_dims, max_gens);
+  } else {
+    if (grid_dims.empty())
+      grid_dims = { 256, 1024, 4096, 16384, 65535 };
+    compare_layouts(grid_dims, max_gens);
+  }
+}
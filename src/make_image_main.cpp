@@ -73,7 +73,7 @@ try
     img_props.set_maxval(s_options.maxval);
 
     std::ios_base::openmode fmode = std::ios::out;
-    if (s_options.format == pgm8::format::RAW) {
+    if (s_options.format != pgm8::format::PLAIN) {
       fmode |= std::ios::binary;
     }
 
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <filesystem>
+#include <string>
+
+#include "util.hpp"
+#include "simulation.hpp"
+
+i32 main(i32 const argc, char const *const *const argv) {
+  if (argc < 2 || argc > 3) {
+    std::cout <<
+      "\n"
+      "Usage:\n"
+      "  materialize <name(generation).delta> [image_format]\n"
+      "                                        ^^^^^^^^^^^^\n"
+      "                                        raw|plain|compressed\n"
+      "\n";
+    return 0;
+  }
+
+  char const *const delta_path_cstr = argv[1];
+  std::filesystem::path const delta_path = delta_path_cstr;
+
+  if (!std::filesystem::is_regular_file(delta_path)) {
+    util::print_err("path '%s' is not a file", delta_path_cstr);
+    return 1;
+  }
+
+  pgm8::format fmt = pgm8::format::NIL;
+  if (argc == 3) {
+    std::string const fmt_val = argv[2];
+    if (fmt_val == "raw")
+      fmt = pgm8::format::RAW;
+    else if (fmt_val == "plain")
+      fmt = pgm8::format::PLAIN;
+    else if (fmt_val == "compressed")
+      fmt = pgm8::format::COMPRESSED;
+    else {
+      util::print_err("image_format must be one of raw|plain|compressed");
+      return 1;
+    }
+  }
+
+  try {
+    std::filesystem::path const img_path = simulation::materialize_delta(delta_path, fmt);
+    std::cout << img_path.generic_string() << '\n';
+  } catch (std::exception const &except) {
+    util::print_err("%s", except.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,12 +1,31 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <future>
 #include <string>
 #include <sstream>
 #include <limits>
+#include <thread>
+#include <vector>
 
+#include <zlib.h>
+
+#include "BS_thread_pool.hpp"
 #include "pgm8.hpp"
+#include "platform.hpp"
+
+#if ON_LINUX
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
 
-uint16_t pgm8::image_properties::get_width() const noexcept { return m_width; }
-uint16_t pgm8::image_properties::get_height() const noexcept { return m_height; }
+uint32_t pgm8::image_properties::get_width() const noexcept { return m_width; }
+uint32_t pgm8::image_properties::get_height() const noexcept { return m_height; }
 uint8_t pgm8::image_properties::get_maxval() const noexcept { return m_maxval; }
 pgm8::format pgm8::image_properties::get_format() const noexcept { return m_fmt; }
 
@@ -23,17 +42,22 @@ void ensure_greater_than_zero(Ty v, char const *const name)
 static
 void ensure_legal_format(pgm8::format const v)
 {
-  if (v != pgm8::format::PLAIN && v != pgm8::format::RAW)
-    throw std::runtime_error("illegal format, must be PLAIN (2) or RAW (5)");
+  if (v != pgm8::format::PLAIN && v != pgm8::format::RAW && v != pgm8::format::COMPRESSED)
+    throw std::runtime_error("illegal format, must be PLAIN (2), RAW (5) or COMPRESSED ('Z')");
+}
+
+char const *pgm8::file_extension(format const fmt)
+{
+  return fmt == format::COMPRESSED ? ".pgmz" : ".pgm";
 }
 
-void pgm8::image_properties::set_width(uint16_t const v)
+void pgm8::image_properties::set_width(uint32_t const v)
 {
   ensure_greater_than_zero(v, "width");
   m_width = v;
   m_width_set = true;
 }
-void pgm8::image_properties::set_height(uint16_t const v)
+void pgm8::image_properties::set_height(uint32_t const v)
 {
   ensure_greater_than_zero(v, "height");
   m_height = v;
@@ -65,6 +89,407 @@ void pgm8::image_properties::validate() const
   if (!m_fmt_set) throw std::runtime_error("format not set");
 }
 
+// Pixel `idx` of an image with `bits` bits per pixel (1, 2, 4 or 8).
+static
+uint8_t get_pixel(uint8_t const *const pixels, size_t const idx, uint8_t const bits)
+{
+  if (bits == 8)
+    return pixels[idx];
+
+  size_t const pixels_per_byte = 8u / bits;
+  unsigned const shift = static_cast<unsigned>(idx % pixels_per_byte) * bits;
+  return static_cast<uint8_t>((pixels[idx / pixels_per_byte] >> shift) & ((1u << bits) - 1));
+}
+
+static
+void set_pixel(uint8_t *const pixels, size_t const idx, uint8_t const bits, uint8_t const value)
+{
+  if (bits == 8) {
+    pixels[idx] = value;
+    return;
+  }
+
+  if (value >> bits)
+    throw std::runtime_error("pixel value " + std::to_string(value) + " doesn't fit in " + std::to_string(bits) + " bits");
+
+  size_t const pixels_per_byte = 8u / bits;
+  unsigned const shift = static_cast<unsigned>(idx % pixels_per_byte) * bits;
+  uint8_t &byte = pixels[idx / pixels_per_byte];
+  byte = static_cast<uint8_t>((byte & ~(((1u << bits) - 1) << shift)) | (unsigned(value) << shift));
+}
+
+// Index of the pixel at (`r`, `c`) within a buffer laid out as described by `read_pixels`.
+static
+size_t pixel_index(size_t const r, size_t const c, size_t const row_stride, size_t const tile_dim)
+{
+  if (tile_dim == 0)
+    return (r * row_stride) + c;
+
+  size_t const tiles_per_row = (row_stride + tile_dim - 1) / tile_dim;
+  size_t const tile = ((r / tile_dim) * tiles_per_row) + (c / tile_dim);
+  return (tile * tile_dim * tile_dim) + ((r % tile_dim) * tile_dim) + (c % tile_dim);
+}
+
+// COMPRESSED images are split into bands of whole rows, about this many
+// pixels each (but at least a row). After the header comes the number of rows
+// per band (u32), then each band as its compressed size (u64), its run-length
+// encoded size (u64) and its run-length encoding, deflated.
+static size_t const s_band_pixels = size_t(1) << 20;
+
+// How many bands of one image are compressed or decompressed at once.
+static
+size_t max_bands_in_flight()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Threads bands are compressed and decompressed on, one per core, shared by
+// every image so concurrent saves (on save threads, or each simulation's own in
+// simulate_many) don't multiply them.
+static
+BS::thread_pool &band_pool()
+{
+  static BS::thread_pool pool(static_cast<BS::concurrency_t>(max_bands_in_flight()));
+  return pool;
+}
+
+static
+void append_varint(std::vector<uint8_t> &out, size_t value)
+{
+  do {
+    uint8_t const byte = static_cast<uint8_t>(value & 0x7f);
+    value >>= 7;
+    out.push_back(value != 0 ? static_cast<uint8_t>(byte | 0x80) : byte);
+  } while (value != 0);
+}
+
+static
+size_t read_varint(uint8_t const *&in, uint8_t const *const end)
+{
+  size_t value = 0;
+  for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+    uint8_t const byte = *in++;
+    value |= size_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  throw std::runtime_error("corrupt band, bad length");
+}
+
+// A band's pixels as tokens, each a varint of (count << 1 | is_run) followed by
+// the pixel repeated `count` times for runs, or `count` pixels as they are.
+// Runs shorter than 4 pixels are left as they are.
+static
+std::vector<uint8_t> run_length_encode(std::vector<uint8_t> const &pixels)
+{
+  std::vector<uint8_t> out{};
+  out.reserve(pixels.size() / 8);
+
+  size_t const num_pixels = pixels.size();
+  size_t literals_start = 0;
+
+  auto const flush_literals = [&](size_t const end) {
+    if (end > literals_start) {
+      append_varint(out, (end - literals_start) << 1);
+      out.insert(out.end(), pixels.begin() + std::ptrdiff_t(literals_start), pixels.begin() + std::ptrdiff_t(end));
+    }
+  };
+
+  for (size_t i = 0; i < num_pixels;) {
+    uint8_t const pixel = pixels[i];
+    size_t const run_end = size_t(std::find_if(pixels.begin() + std::ptrdiff_t(i), pixels.end(),
+      [pixel](uint8_t const p) { return p != pixel; }) - pixels.begin());
+
+    if (run_end - i >= 4) {
+      flush_literals(i);
+      append_varint(out, ((run_end - i) << 1) | 1);
+      out.push_back(pixel);
+      literals_start = run_end;
+    }
+    i = run_end;
+  }
+  flush_literals(num_pixels);
+
+  return out;
+}
+
+static
+std::vector<uint8_t> run_length_decode(std::vector<uint8_t> const &encoded, size_t const num_pixels)
+{
+  std::vector<uint8_t> pixels(num_pixels);
+  uint8_t const *in = encoded.data();
+  uint8_t const *const end = encoded.data() + encoded.size();
+  size_t out = 0;
+
+  while (in < end) {
+    size_t const token = read_varint(in, end);
+    size_t const count = token >> 1;
+    bool const is_run = (token & 1) != 0;
+
+    if (count > num_pixels - out || (is_run ? 1 : count) > size_t(end - in))
+      throw std::runtime_error("corrupt band, overruns its pixels");
+
+    if (is_run) {
+      std::fill_n(pixels.data() + out, count, *in++);
+    } else {
+      std::memcpy(pixels.data() + out, in, count);
+      in += count;
+    }
+    out += count;
+  }
+
+  if (out != num_pixels)
+    throw std::runtime_error("corrupt band, too few pixels");
+
+  return pixels;
+}
+
+struct compressed_band
+{
+  std::vector<uint8_t> data;
+  uint64_t encoded_size;
+};
+
+static
+compressed_band compress_band(std::vector<uint8_t> const &pixels)
+{
+  std::vector<uint8_t> const encoded = run_length_encode(pixels);
+
+  uLongf size = compressBound(static_cast<uLong>(encoded.size()));
+  std::vector<uint8_t> data(size);
+  if (compress2(data.data(), &size, encoded.data(), static_cast<uLong>(encoded.size()), Z_BEST_SPEED) != Z_OK)
+    throw std::runtime_error("failed to compress band");
+  data.resize(size);
+
+  return { std::move(data), encoded.size() };
+}
+
+static
+std::vector<uint8_t> decompress_band(compressed_band const &band, size_t const num_pixels)
+{
+  std::vector<uint8_t> encoded(band.encoded_size);
+  uLongf size = static_cast<uLongf>(band.encoded_size);
+  if (uncompress(encoded.data(), &size, band.data.data(), static_cast<uLong>(band.data.size())) != Z_OK || size != band.encoded_size)
+    throw std::runtime_error("corrupt band, failed to decompress");
+
+  return run_length_decode(encoded, num_pixels);
+}
+
+// The pixels of a COMPRESSED image, past the header.
+static
+void read_compressed_rows(
+  std::ifstream &file,
+  pgm8::image_properties const props,
+  std::function<void (size_t row, uint8_t const *pixels)> const &write_row)
+{
+  size_t const width = props.get_width(), height = props.get_height();
+
+  uint32_t rows_per_band = 0;
+  file.read(reinterpret_cast<char *>(&rows_per_band), sizeof(rows_per_band));
+  if (!file || rows_per_band == 0)
+    throw std::runtime_error("invalid rows per band");
+
+  // bands are read in order, decompressed on `band_pool` and handed to
+  // `write_row` in order
+  std::deque<std::future<std::vector<uint8_t>>> in_flight{};
+  size_t next_row = 0;
+
+  auto const hand_over_band = [&] {
+    std::vector<uint8_t> const pixels = in_flight.front().get();
+    in_flight.pop_front();
+    for (size_t r = 0; r < pixels.size() / width; ++r, ++next_row)
+      write_row(next_row, pixels.data() + (r * width));
+  };
+
+  for (size_t r = 0; r < height; r += rows_per_band) {
+    size_t const num_pixels = std::min(size_t(rows_per_band), height - r) * width;
+
+    uint64_t sizes[2];
+    file.read(reinterpret_cast<char *>(sizes), sizeof(sizes));
+    // a run-length encoding is never more than a varint per pixel bigger, and
+    // deflating it never more than compressBound
+    if (!file || sizes[1] > num_pixels + (num_pixels / 64) + 16 || sizes[0] > compressBound(static_cast<uLong>(sizes[1])))
+      throw std::runtime_error("unexpected end of file or corrupt band at row " + std::to_string(r));
+
+    auto const band = std::make_shared<compressed_band>(compressed_band{ std::vector<uint8_t>(sizes[0]), sizes[1] });
+    file.read(reinterpret_cast<char *>(band->data.data()), std::streamsize(band->data.size()));
+    if (static_cast<size_t>(file.gcount()) != band->data.size())
+      throw std::runtime_error("unexpected end of file at row " + std::to_string(r));
+
+    if (in_flight.size() == max_bands_in_flight())
+      hand_over_band();
+    in_flight.push_back(band_pool().submit([band, num_pixels] {
+      return decompress_band(*band, num_pixels);
+    }));
+  }
+
+  while (!in_flight.empty())
+    hand_over_band();
+}
+
+// Copies row `r` of an image into `buffer`, laid out as described by `read_pixels`.
+static
+void store_row(
+  uint8_t *const buffer,
+  size_t const r,
+  uint8_t const *const row,
+  size_t const width,
+  size_t const row_stride,
+  uint8_t const bits_per_pixel,
+  size_t const tile_dim)
+{
+  if (tile_dim > 0) {
+    for (size_t c = 0; c < width; c += tile_dim)
+      std::memcpy(buffer + pixel_index(r, c, row_stride, tile_dim), row + c, std::min(tile_dim, width - c));
+  } else if (bits_per_pixel < 8) {
+    for (size_t c = 0; c < width; ++c)
+      set_pixel(buffer, (r * row_stride) + c, bits_per_pixel, row[c]);
+  } else {
+    std::memcpy(buffer + (r * row_stride), row, width);
+  }
+}
+
+// The reverse of `store_row`.
+static
+void load_row(
+  uint8_t *const row,
+  uint8_t const *const pixels,
+  size_t const r,
+  size_t const width,
+  size_t const row_stride,
+  uint8_t const bits_per_pixel,
+  size_t const tile_dim)
+{
+  if (tile_dim > 0) {
+    for (size_t c = 0; c < width; c += tile_dim)
+      std::memcpy(row + c, pixels + pixel_index(r, c, row_stride, tile_dim), std::min(tile_dim, width - c));
+  } else if (bits_per_pixel < 8) {
+    for (size_t c = 0; c < width; ++c)
+      row[c] = get_pixel(pixels, (r * row_stride) + c, bits_per_pixel);
+  } else {
+    std::memcpy(row, pixels + (r * row_stride), width);
+  }
+}
+
+// PLAIN pixels are read and written through buffers this big, rather than a
+// stream call per pixel.
+static size_t const s_plain_buffer_bytes = size_t(1) << 20;
+
+// "0 " through "255 ", padded to 4 bytes so each can be copied in one go.
+struct plain_pixel_text
+{
+  char text[256][4];
+  uint8_t len[256];
+};
+
+static plain_pixel_text const s_plain_pixel_text = []() {
+  plain_pixel_text table{};
+  for (unsigned pixel = 0; pixel < 256; ++pixel) {
+    std::string const text = std::to_string(pixel) + ' ';
+    std::memcpy(table.text[pixel], text.data(), text.size());
+    table.len[pixel] = static_cast<uint8_t>(text.size());
+  }
+  return table;
+}();
+
+// Formats rows of PLAIN pixels into a buffer, written out whenever it fills up.
+class plain_row_writer
+{
+public:
+  plain_row_writer(std::fstream &file, size_t const width)
+    : m_file(file), m_buffer(std::max(s_plain_buffer_bytes, (width * 4) + 1)), m_size(0)
+  {}
+
+  void write_row(uint8_t const *const row, size_t const width)
+  {
+    if (m_buffer.size() - m_size < (width * 4) + 1)
+      flush();
+
+    char *out = m_buffer.data() + m_size;
+    for (size_t c = 0; c < width; ++c) {
+      std::memcpy(out, s_plain_pixel_text.text[row[c]], 4);
+      out += s_plain_pixel_text.len[row[c]];
+    }
+    *out++ = '\n';
+    m_size = size_t(out - m_buffer.data());
+  }
+
+  void flush()
+  {
+    m_file.write(m_buffer.data(), std::streamsize(m_size));
+    m_size = 0;
+  }
+
+private:
+  std::fstream &m_file;
+  std::vector<char> m_buffer;
+  size_t m_size;
+};
+
+// Parses PLAIN pixels out of big reads of the file.
+class plain_pixel_reader
+{
+public:
+  explicit plain_pixel_reader(std::ifstream &file)
+    : m_file(file), m_buffer(s_plain_buffer_bytes), m_pos(0), m_end(0)
+  {}
+
+  void read_row(uint8_t *const row, size_t const width, size_t const r)
+  {
+    for (size_t c = 0; c < width; ++c)
+      row[c] = next(r, c);
+  }
+
+private:
+  // Moves what's left to the front and reads in as much as fits after it,
+  // returns false if nothing more could be read.
+  bool refill()
+  {
+    size_t const left = m_end - m_pos;
+    std::memmove(m_buffer.data(), m_buffer.data() + m_pos, left);
+    m_pos = 0;
+    m_end = left;
+    if (!m_file)
+      return false;
+    m_file.read(m_buffer.data() + left, std::streamsize(m_buffer.size() - left));
+    m_end += static_cast<size_t>(m_file.gcount());
+    return m_end > left;
+  }
+
+  static bool is_space(char const ch)
+  {
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\v' || ch == '\f';
+  }
+
+  uint8_t next(size_t const r, size_t const c)
+  {
+    for (;;) {
+      while (m_pos < m_end && is_space(m_buffer[m_pos]))
+        ++m_pos;
+      if (m_pos < m_end)
+        break;
+      if (!refill())
+        throw std::runtime_error("unexpected end of file at row " + std::to_string(r));
+    }
+
+    // so a pixel is never cut off by the end of the buffer
+    if (m_end - m_pos < 16)
+      refill();
+
+    unsigned value = 0;
+    auto const [end, ec] = std::from_chars(m_buffer.data() + m_pos, m_buffer.data() + m_end, value);
+    if (ec != std::errc() || value > 255)
+      throw std::runtime_error("invalid pixel at row " + std::to_string(r) + ", column " + std::to_string(c));
+    m_pos = size_t(end - m_buffer.data());
+
+    return static_cast<uint8_t>(value);
+  }
+
+  std::ifstream &m_file;
+  std::vector<char> m_buffer;
+  size_t m_pos, m_end;
+};
+
 pgm8::image_properties pgm8::read_properties(std::ifstream &file)
 {
   if (!file)
@@ -76,14 +501,18 @@ pgm8::image_properties pgm8::read_properties(std::ifstream &file)
     std::getline(file, magic_num);
     if (magic_num.starts_with("P5"))
       return format::RAW;
+    else if (magic_num.starts_with("PZ"))
+      return format::COMPRESSED;
     else if (magic_num.starts_with("P2"))
       return format::PLAIN;
     else
       throw std::runtime_error("invalid magic number, corrupt or non-PGM file");
   }();
 
-  uint16_t width, height;
+  uint32_t width, height;
   file >> width >> height;
+  if (!file)
+    throw std::runtime_error("invalid width or height, must be in range [1, " + std::to_string(UINT32_MAX) + "]");
 
   uint8_t maxval;
   {
@@ -104,7 +533,10 @@ pgm8::image_properties pgm8::read_properties(std::ifstream &file)
 void pgm8::read_pixels(
   std::ifstream &file,
   image_properties const props,
-  uint8_t *const buffer)
+  uint8_t *const buffer,
+  size_t row_stride,
+  uint8_t const bits_per_pixel,
+  size_t const tile_dim)
 {
   // eat the \n between maxval and pixel data
   {
@@ -113,32 +545,230 @@ void pgm8::read_pixels(
     assert(file.gcount() == sizeof(char));
   }
 
-  size_t const num_pixels = static_cast<size_t>(props.get_width()) * props.get_height();
+  size_t const width = props.get_width(), height = props.get_height();
+  size_t const num_pixels = width * height;
+  if (row_stride == 0)
+    row_stride = width;
 
-  if (props.get_format() == pgm8::format::RAW)
+  if (props.get_format() == pgm8::format::COMPRESSED)
   {
-    assert(num_pixels <= std::numeric_limits<std::streamsize>::max());
-    file.read(reinterpret_cast<char *>(buffer), std::streamsize(num_pixels));
-    assert(file.gcount() > 0 && static_cast<size_t>(file.gcount()) == num_pixels);
+    read_compressed_rows(file, props, [&](size_t const r, uint8_t const *const row) {
+      store_row(buffer, r, row, width, row_stride, bits_per_pixel, tile_dim);
+    });
+  }
+  else if (props.get_format() == pgm8::format::RAW)
+  {
+    if (tile_dim > 0) {
+      // each row is a run of whole tile rows
+      std::vector<uint8_t> row(width);
+      for (size_t r = 0; r < height; ++r) {
+        file.read(reinterpret_cast<char *>(row.data()), std::streamsize(width));
+        assert(file.gcount() > 0 && static_cast<size_t>(file.gcount()) == width);
+        for (size_t c = 0; c < width; c += tile_dim)
+          std::memcpy(buffer + pixel_index(r, c, row_stride, tile_dim), row.data() + c, std::min(tile_dim, width - c));
+      }
+    } else if (bits_per_pixel < 8) {
+      std::vector<uint8_t> row(width);
+      for (size_t r = 0; r < height; ++r) {
+        file.read(reinterpret_cast<char *>(row.data()), std::streamsize(width));
+        assert(file.gcount() > 0 && static_cast<size_t>(file.gcount()) == width);
+        for (size_t c = 0; c < width; ++c)
+          set_pixel(buffer, (r * row_stride) + c, bits_per_pixel, row[c]);
+      }
+    } else if (row_stride == width) {
+      assert(num_pixels <= std::numeric_limits<std::streamsize>::max());
+      file.read(reinterpret_cast<char *>(buffer), std::streamsize(num_pixels));
+      assert(file.gcount() > 0 && static_cast<size_t>(file.gcount()) == num_pixels);
+    } else {
+      for (size_t r = 0; r < height; ++r) {
+        file.read(reinterpret_cast<char *>(buffer + (r * row_stride)), std::streamsize(width));
+        assert(file.gcount() > 0 && static_cast<size_t>(file.gcount()) == width);
+      }
+    }
   }
   else // format::PLAIN
   {
-    char pixel[4] {};
-    for (size_t i = 0; i < num_pixels; ++i) {
-      file >> pixel;
-      buffer[i] = static_cast<uint8_t>(std::stoul(pixel));
+    plain_pixel_reader reader(file);
+    std::vector<uint8_t> row(width);
+    for (size_t r = 0; r < height; ++r) {
+      reader.read_row(row.data(), width, r);
+      store_row(buffer, r, row.data(), width, row_stride, bits_per_pixel, tile_dim);
     }
   }
 }
 
-bool pgm8::write(
-  std::fstream &file,
+void pgm8::read_rows(
+  std::ifstream &file,
   image_properties const props,
-  uint8_t const *pixels)
+  std::function<void (size_t row, uint8_t const *pixels)> const &write_row)
+{
+  // eat the \n between maxval and pixel data
+  {
+    char newline;
+    file.read(&newline, 1);
+    assert(file.gcount() == sizeof(char));
+  }
+
+  if (props.get_format() == format::COMPRESSED) {
+    read_compressed_rows(file, props, write_row);
+    return;
+  }
+
+  size_t const width = props.get_width(), height = props.get_height();
+  std::vector<uint8_t> row(width);
+
+  if (props.get_format() == format::PLAIN) {
+    plain_pixel_reader reader(file);
+    for (size_t r = 0; r < height; ++r) {
+      reader.read_row(row.data(), width, r);
+      write_row(r, row.data());
+    }
+    return;
+  }
+
+  for (size_t r = 0; r < height; ++r) {
+    file.read(reinterpret_cast<char *>(row.data()), std::streamsize(width));
+    if (static_cast<size_t>(file.gcount()) != width)
+      throw std::runtime_error("unexpected end of file at row " + std::to_string(r));
+    write_row(r, row.data());
+  }
+}
+
+void pgm8::read_pixels(
+  uint8_t const *const raster,
+  image_properties const props,
+  uint8_t *const buffer,
+  size_t row_stride,
+  uint8_t const bits_per_pixel,
+  size_t const tile_dim)
+{
+  size_t const width = props.get_width(), height = props.get_height();
+  if (row_stride == 0)
+    row_stride = width;
+
+  if (tile_dim == 0 && bits_per_pixel == 8 && row_stride == width) {
+    std::memcpy(buffer, raster, width * height);
+    return;
+  }
+
+  for (size_t r = 0; r < height; ++r)
+    store_row(buffer, r, raster + (r * width), width, row_stride, bits_per_pixel, tile_dim);
+}
+
+// Parses an unsigned decimal at `pos`, after any whitespace, leaving `pos` just
+// past it. Returns false if there isn't one.
+static
+bool parse_header_field(char const *&pos, char const *const end, unsigned long &value)
+{
+  while (pos < end && std::isspace(static_cast<unsigned char>(*pos)))
+    ++pos;
+  auto const [num_end, ec] = std::from_chars(pos, end, value);
+  if (ec != std::errc())
+    return false;
+  pos = num_end;
+  return true;
+}
+
+bool pgm8::map_raw(char const *const path, mapped_image &image, bool const sequential)
+{
+#if ON_LINUX
+  int const fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat info{};
+  if (fstat(fd, &info) != 0 || info.st_size < 2) {
+    close(fd);
+    return false;
+  }
+
+  size_t const file_size = static_cast<size_t>(info.st_size);
+  void *const addr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file open
+  if (addr == MAP_FAILED)
+    return false;
+
+  uint8_t *const mapping = static_cast<uint8_t *>(addr);
+  char const *const begin = reinterpret_cast<char const *>(mapping);
+  char const *const end = begin + file_size;
+
+  if (begin[0] != 'P' || begin[1] != '5') {
+    munmap(addr, file_size);
+    return false;
+  }
+
+  // same as `read_properties`, the magic number, width, height and maxval, then
+  // a single whitespace character before the pixels
+  try {
+    char const *pos = begin + 2;
+    unsigned long width, height, maxval;
+    if (!parse_header_field(pos, end, width) || !parse_header_field(pos, end, height)
+      || width > UINT32_MAX || height > UINT32_MAX)
+    {
+      throw std::runtime_error("invalid width or height, must be in range [1, " + std::to_string(UINT32_MAX) + "]");
+    }
+    if (!parse_header_field(pos, end, maxval) || pos == end)
+      throw std::runtime_error("invalid maxval");
+
+    image.props = image_properties{};
+    image.props.set_width(static_cast<uint32_t>(width));
+    image.props.set_height(static_cast<uint32_t>(height));
+    image.props.set_maxval(static_cast<uint8_t>(maxval));
+    image.props.set_format(format::RAW);
+    image.pixel_offset = static_cast<size_t>(pos + 1 - begin);
+  } catch (...) {
+    munmap(addr, file_size);
+    throw;
+  }
+
+  image.mapping = mapping;
+  image.num_bytes = image.pixel_offset + image.props.num_pixels();
+  if (image.num_bytes > file_size) {
+    munmap(addr, file_size);
+    throw std::runtime_error("unexpected end of file, " + std::to_string(image.num_bytes - file_size) + " bytes short");
+  }
+
+  // anything past the pixels, or before the page they start on, is no use to
+  // anyone
+  size_t const page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t const mapped_end = ((image.num_bytes + page_size - 1) / page_size) * page_size;
+  if (mapped_end < file_size)
+    munmap(mapping + mapped_end, file_size - mapped_end);
+  size_t const mapped_begin = (image.pixel_offset / page_size) * page_size;
+  if (mapped_begin > 0) {
+    munmap(mapping, mapped_begin);
+    image.mapping += mapped_begin;
+    image.num_bytes -= mapped_begin;
+    image.pixel_offset -= mapped_begin;
+  }
+
+  if (sequential)
+    madvise(image.mapping, image.num_bytes, MADV_SEQUENTIAL);
+
+  return true;
+#else
+  (void)path;
+  (void)image;
+  (void)sequential;
+  return false;
+#endif
+}
+
+void pgm8::unmap(mapped_image &image)
+{
+#if ON_LINUX
+  if (image.mapping != nullptr)
+    munmap(image.mapping, image.num_bytes);
+#endif
+  image.mapping = nullptr;
+  image.num_bytes = 0;
+}
+
+std::string pgm8::header(image_properties const props)
 {
   props.validate();
 
-  uint16_t const width = props.get_width(), height = props.get_height();
+  uint32_t const width = props.get_width(), height = props.get_height();
   uint8_t const maxval = props.get_maxval();
   format const fmt = props.get_format();
 
@@ -147,30 +777,128 @@ bool pgm8::write(
   ensure_greater_than_zero(props.get_maxval(), "maxval");
   ensure_legal_format(fmt);
 
-  // header
-  {
-    int const magic_num = (fmt == format::RAW) ? 5 : /* format::PLAIN */ 2;
-    file
-      << 'P' << magic_num << '\n'
-      << std::to_string(width) << ' ' << std::to_string(height) << '\n'
-      << std::to_string(maxval) << (fmt == format::RAW ? ' ' : '\n');
+  char const magic_num = fmt == format::COMPRESSED ? 'Z' : fmt == format::RAW ? '5' : /* format::PLAIN */ '2';
+  return
+    'P' + std::string(1, magic_num) + '\n' +
+    std::to_string(width) + ' ' + std::to_string(height) + '\n' +
+    std::to_string(maxval) + (fmt == format::RAW ? ' ' : '\n');
+}
+
+static
+void write_header(std::fstream &file, pgm8::image_properties const props)
+{
+  file << pgm8::header(props);
+}
+
+bool pgm8::write_rows(
+  std::fstream &file,
+  image_properties const props,
+  std::function<void (size_t row, uint8_t *pixels)> const &read_row)
+{
+  write_header(file, props);
+
+  size_t const width = props.get_width(), height = props.get_height();
+
+  if (props.get_format() == format::COMPRESSED) {
+    // bands are gathered in order, compressed on `band_pool` and written in
+    // order
+    size_t const rows_per_band = std::max(size_t(1), s_band_pixels / width);
+    uint32_t const rows_per_band_u32 = static_cast<uint32_t>(std::min(rows_per_band, size_t(height)));
+    file.write(reinterpret_cast<char const *>(&rows_per_band_u32), sizeof(rows_per_band_u32));
+
+    std::deque<std::future<compressed_band>> in_flight{};
+
+    auto const write_band = [&] {
+      compressed_band const band = in_flight.front().get();
+      in_flight.pop_front();
+      uint64_t const sizes[2] { band.data.size(), band.encoded_size };
+      file.write(reinterpret_cast<char const *>(sizes), sizeof(sizes));
+      file.write(reinterpret_cast<char const *>(band.data.data()), std::streamsize(band.data.size()));
+    };
+
+    for (size_t r = 0; r < height; r += rows_per_band_u32) {
+      size_t const num_rows = std::min(size_t(rows_per_band_u32), height - r);
+      auto const pixels = std::make_shared<std::vector<uint8_t>>(num_rows * width);
+      for (size_t i = 0; i < num_rows; ++i)
+        read_row(r + i, pixels->data() + (i * width));
+
+      if (in_flight.size() == max_bands_in_flight())
+        write_band();
+      in_flight.push_back(band_pool().submit([pixels] {
+        return compress_band(*pixels);
+      }));
+    }
+
+    while (!in_flight.empty())
+      write_band();
+
+    return !file.bad();
   }
 
-  // pixels
-  if (fmt == format::RAW)
-  {
-    size_t const num_pixels = static_cast<size_t>(width) * height;
-    assert(num_pixels <= std::numeric_limits<std::streamsize>::max());
-    file.write(reinterpret_cast<char const *>(pixels), std::streamsize(num_pixels));
+  std::vector<uint8_t> row(width);
+
+  if (props.get_format() == format::PLAIN) {
+    plain_row_writer writer(file, width);
+    for (size_t r = 0; r < height; ++r) {
+      read_row(r, row.data());
+      writer.write_row(row.data(), width);
+    }
+    writer.flush();
+    return !file.bad();
   }
-  else // format::PLAIN
-  {
-    for (size_t r = 0; r < height; ++r)
-    {
+
+  for (size_t r = 0; r < height; ++r) {
+    read_row(r, row.data());
+    file.write(reinterpret_cast<char const *>(row.data()), std::streamsize(width));
+  }
+
+  return !file.bad();
+}
+
+bool pgm8::write(
+  std::fstream &file,
+  image_properties const props,
+  uint8_t const *pixels,
+  size_t row_stride,
+  uint8_t const bits_per_pixel,
+  size_t const tile_dim)
+{
+  size_t const width = props.get_width(), height = props.get_height();
+  format const fmt = props.get_format();
+
+  if (row_stride == 0)
+    row_stride = width;
+
+  if (fmt == format::COMPRESSED || fmt == format::PLAIN) {
+    return write_rows(file, props, [&](size_t const r, uint8_t *const row) {
+      load_row(row, pixels, r, width, row_stride, bits_per_pixel, tile_dim);
+    });
+  }
+
+  write_header(file, props);
+
+  // pixels, format::RAW
+  if (tile_dim > 0) {
+    std::vector<uint8_t> row(width);
+    for (size_t r = 0; r < height; ++r) {
+      for (size_t c = 0; c < width; c += tile_dim)
+        std::memcpy(row.data() + c, pixels + pixel_index(r, c, row_stride, tile_dim), std::min(tile_dim, width - c));
+      file.write(reinterpret_cast<char const *>(row.data()), std::streamsize(width));
+    }
+  } else if (bits_per_pixel < 8) {
+    std::vector<uint8_t> row(width);
+    for (size_t r = 0; r < height; ++r) {
       for (size_t c = 0; c < width; ++c)
-        file << std::to_string(pixels[(r * width) + c]) << ' ';
-      file << '\n';
+        row[c] = get_pixel(pixels, (r * row_stride) + c, bits_per_pixel);
+      file.write(reinterpret_cast<char const *>(row.data()), std::streamsize(width));
     }
+  } else if (row_stride == width) {
+    size_t const num_pixels = width * height;
+    assert(num_pixels <= std::numeric_limits<std::streamsize>::max());
+    file.write(reinterpret_cast<char const *>(pixels), std::streamsize(num_pixels));
+  } else {
+    for (size_t r = 0; r < height; ++r)
+      file.write(reinterpret_cast<char const *>(pixels + (r * row_stride)), std::streamsize(width));
   }
 
   return !file.bad();
@@ -2,6 +2,8 @@
 #define NLUKA_PGM8_HPP
 
 #include <fstream>
+#include <functional>
+#include <string>
 
 // Module for reading and writing 8-bit PGM images.
 namespace pgm8 {
@@ -13,18 +15,25 @@ enum class format : uint8_t
   PLAIN = 2,
   // Pixels stored in binary raster.
   RAW = 5,
+  // Not actually PGM (magic number PZ), pixels stored in bands of rows, each
+  // run-length encoded and deflated on its own so that bands can be compressed
+  // and decompressed in parallel. See the README for the layout.
+  COMPRESSED = 'Z',
 };
 
+// ".pgmz" for COMPRESSED images, ".pgm" otherwise.
+[[nodiscard]] char const *file_extension(format);
+
 struct image_properties
 {
 public:
-  [[nodiscard]] uint16_t get_width() const noexcept;
-  [[nodiscard]] uint16_t get_height() const noexcept;
+  [[nodiscard]] uint32_t get_width() const noexcept;
+  [[nodiscard]] uint32_t get_height() const noexcept;
   [[nodiscard]] uint8_t get_maxval() const noexcept;
   [[nodiscard]] pgm8::format get_format() const noexcept;
 
-  void set_width(uint16_t);
-  void set_height(uint16_t);
+  void set_width(uint32_t);
+  void set_height(uint32_t);
   void set_maxval(uint8_t);
   void set_format(format);
 
@@ -33,7 +42,7 @@ public:
   void validate() const;
 
 private:
-  uint16_t m_width = 0, m_height = 0;
+  uint32_t m_width = 0, m_height = 0;
   uint8_t m_maxval = 0;
   format m_fmt = format::NIL;
   bool
@@ -45,16 +54,88 @@ private:
 
 [[nodiscard]] image_properties read_properties(std::ifstream &file);
 
+// What `write` puts before the pixels, for RAW images they follow right after.
+[[nodiscard]] std::string header(image_properties props);
+
+// `row_stride` is the distance in pixels between the starts of consecutive
+// rows in `buffer`, 0 means rows are tightly packed (row_stride == width).
+// `bits_per_pixel` below 8 (1, 2 or 4) packs that many pixels to a byte,
+// lowest bits first, pixel values which don't fit are an error.
+// `tile_dim` above 0 means `buffer` is made of tile_dim x tile_dim tiles, each
+// stored row by row, laid out row by row themselves with enough tiles to cover
+// `row_stride` pixels per row. Right and bottom tiles may hang off the image.
 void read_pixels(
   std::ifstream &file,
   image_properties props,
-  uint8_t *buffer
+  uint8_t *buffer,
+  size_t row_stride = 0,
+  uint8_t bits_per_pixel = 8,
+  size_t tile_dim = 0
 );
 
+// `row_stride` is the distance in pixels between the starts of consecutive
+// rows in `pixels`, 0 means rows are tightly packed (row_stride == width).
+// `bits_per_pixel` and `tile_dim` are as for `read_pixels`, the file is
+// always 8-bit and row by row.
 bool write(
   std::fstream &file,
   image_properties props,
-  uint8_t const *pixels
+  uint8_t const *pixels,
+  size_t row_stride = 0,
+  uint8_t bits_per_pixel = 8,
+  size_t tile_dim = 0
+);
+
+// `read_pixels` for the pixels of a RAW image already in memory, e.g. mapped by
+// `map_raw`.
+void read_pixels(
+  uint8_t const *raster,
+  image_properties props,
+  uint8_t *buffer,
+  size_t row_stride = 0,
+  uint8_t bits_per_pixel = 8,
+  size_t tile_dim = 0
+);
+
+// A RAW image mapped into memory by `map_raw`.
+struct mapped_image
+{
+  image_properties props;
+  // the pixels and whatever comes before them on the page they start on,
+  // which is all or part of the header
+  uint8_t *mapping;
+  size_t num_bytes;
+  size_t pixel_offset; // where the pixels start in `mapping`, within its first page
+};
+
+// Maps the RAW image at `path` copy-on-write, so the pixels can be written to
+// without ever reaching the file, and parses its header in place. Pages are
+// only read in as they're touched, `sequential` tells the OS they'll be touched
+// front to back so it reads well ahead. Returns false, having mapped nothing,
+// for images in other formats or files which can't be mapped (always on
+// platforms other than Linux), which are up to `read_properties` and
+// `read_pixels`. Throws like them for bad headers and missing pixels.
+bool map_raw(char const *path, mapped_image &image, bool sequential);
+
+// Unmaps what `map_raw` mapped.
+void unmap(mapped_image &image);
+
+// Like `write`, for pixels which aren't all in memory at once. `read_row` is
+// called with each row index in turn and has to fill in that row's pixels.
+bool write_rows(
+  std::fstream &file,
+  image_properties props,
+  std::function<void (size_t row, uint8_t *pixels)> const &read_row
+);
+
+// Like `read_pixels`, for images which don't fit in memory at once (or are
+// stored in a way `read_pixels` doesn't know about). `write_row` is called with
+// each row index in turn and that row's pixels, which are only valid until it
+// returns.
+void read_rows(
+  std::ifstream &file,
+  image_properties props,
+  std::function<void (size_t row, uint8_t const *pixels)> const &write_row
 );
 
 } // namespace pgm8
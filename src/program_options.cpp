@@ -80,6 +80,17 @@ namespace simulation
   option save_final_state() { return { "save_final_state", 's' }; }
   option save_points()      { return { "save_points",      'p' }; }
   option save_interval()    { return { "save_interval",    'v' }; }
+  option grid_layout()      { return { "grid_layout",      'G' }; }
+  option huge_pages()       { return { "huge_pages",       'P' }; }
+  option engine()           { return { "engine",           'E' }; }
+  option memo_table_mib()   { return { "memo_table_mib",   'M' }; }
+  option fast_forward_highways() { return { "fast_forward_highways", 'H' }; }
+  option grow_to()          { return { "grow_to",          'D' }; }
+  option save_threads()     { return { "save_threads",     'W' }; }
+  option save_buffer_mib()  { return { "save_buffer_mib",  'K' }; }
+  option live_grid_file()   { return { "live_grid_file",   'F' }; }
+  option delta_saves()      { return { "delta_saves",      'R' }; }
+  option checkpoint_saves() { return { "checkpoint_saves", 'c' }; }
 }
 
 namespace simulate_one
@@ -93,6 +104,8 @@ namespace simulate_many
 {
   option num_threads()    { return { "num_threads",    'T' }; }
   option queue_size()     { return { "queue_size",     'Q' }; }
+  option batch_size()     { return { "batch_size",     'B' }; }
+  option interleave()     { return { "interleave",     'I' }; }
   option state_dir_path() { return { "state_dir_path", 'S' }; }
   option log_to_stdout()  { return { "log_to_stdout",  'C' }; }
   option log_file_path()  { return { "log_file_path",  'L' }; }
@@ -164,7 +177,7 @@ options_description po::make_image_options_description()
       value<string>(), "Output PGM file path.")
 
     (fmt(make_image::format()).c_str(),
-      value<string>(), "PGM image format, raw|plain.")
+      value<string>(), "PGM image format, raw|plain|compressed. Compressed images (.pgmz) are run-length encoded and deflated in bands of rows, compressed in parallel.")
 
     (fmt(make_image::content()).c_str(),
       value<string>(), make_str("Type of image content, /%s/.", make_image::regex_content()).c_str())
@@ -203,10 +216,10 @@ options_description po::make_states_options_description()
                            make_states::out_dir_path().full_name ).c_str())
 
     (fmt(make_states::grid_width()).c_str(),
-      value<i32>(), "Value of 'grid_width' for all generated states, [1, 65535].")
+      value<i32>(), "Value of 'grid_width' for all generated states, [1, 1048576].")
 
     (fmt(make_states::grid_height()).c_str(),
-      value<i32>(), "Value of 'grid_height' for all generated states, [1, 65535].")
+      value<i32>(), "Value of 'grid_height' for all generated states, [1, 1048576].")
 
     (fmt(make_states::ant_col()).c_str(),
       value<i32>(), "Value of 'ant_col' for all generated states, [0, grid_width).")
@@ -271,7 +284,7 @@ options_description simulation_options_description()
       value<string>(), "Generation limit, if reached the simulation will stop, 0 means max uint64.")
 
     (fmt(simulation::image_format()).c_str(),
-      value<string>(), "PGM image format for saves, raw|plain.")
+      value<string>(), "PGM image format for saves, raw|plain|compressed. Compressed images (<name>(<generation>).pgmz) are run-length encoded and deflated in bands of rows, compressed in parallel on one thread per core shared by all saves, and written on a save thread by default (see --save_threads). Grids bigger than --save_buffer_mib are still compressed while the simulation waits. Also read back as grid_state.")
 
     (fmt(simulation::create_logs()).c_str(),
       /* flag */ "Create a log entry when a save is made.")
@@ -290,6 +303,39 @@ options_description simulation_options_description()
 
     (fmt(simulation::save_interval()).c_str(),
       value<u64>(), "Generation interval at which to save.")
+
+    (fmt(simulation::grid_layout()).c_str(),
+      value<string>(), "Grid memory layout, dense|bordered|packed|tiled|sparse. Bordered skips per-step bounds checks, but needs a shade without a rule. Packed stores 1, 2 or 4 bits per cell for rulesets with up to 16 shades. Tiled stores 64x64 blocks of cells together, so vertical moves stay within the same page. Sparse is tiled, but only allocates the blocks the ant visits (and, for images, blocks not entirely of the lowest ruled shade).")
+
+    (fmt(simulation::huge_pages()).c_str(),
+      value<string>(), "Pages backing dense, packed and tiled grids, off|thp|hugetlb, default off. Thp asks for transparent 2 MiB pages, hugetlb maps 2 MiB pages reserved beforehand (vm.nr_hugepages) and falls back to thp. Huge pages cut TLB misses on vertical moves through big grids, but are backed by memory 2 MiB at a time.")
+
+    (fmt(simulation::engine()).c_str(),
+      value<string>(), "Stepping engine, kernel|memo|window. Memo remembers the ant's trips through 8x8 tiles, which pays off once it settles into repetitive structures. Window steps within a copy of the 256x256 cells around the ant, which stays in cache however big the grid.")
+
+    (fmt(simulation::memo_table_mib()).c_str(),
+      value<u64>(), "Memory cap for the memo engine's table in MiB, default 64.")
+
+    (fmt(simulation::fast_forward_highways()).c_str(),
+      /* flag */ "Detect when the ant builds a highway and jump ahead to the edge or generation limit, final states are identical.")
+
+    (fmt(simulation::grow_to()).c_str(),
+      value<u64>(), "Grow grids the ant steps off instead of stopping, up to arg x arg cells (at most 1048576). Each time, the grid doubles in size, or grows as far as the cap allows, with the old one as near the middle as leaves room on the side the ant stepped off, and new cells of the fill shade (the lowest ruled shade for images). Saves record where the original top left cell ended up as origin_col and origin_row.")
+
+    (fmt(simulation::save_threads()).c_str(),
+      value<u64>(), "Number of threads to write saves on, default 0 (1 with --image_format compressed). With any, a save only holds up stepping while the grid is copied, unless the copies waiting to be written already take up --save_buffer_mib.")
+
+    (fmt(simulation::save_buffer_mib()).c_str(),
+      value<u64>(), "Memory cap for copies of grids waiting to be written by --save_threads in MiB, default 256. Grids bigger than that are saved without copying.")
+
+    (fmt(simulation::live_grid_file()).c_str(),
+      /* flag */ "Keep dense grids in a raw image next to their saves while simulating (<name>.live.pgm), which saves then copy rather than writing out the grid. The final save renames it instead. Needs --image_format raw.")
+
+    (fmt(simulation::delta_saves()).c_str(),
+      value<u64>(), "Make only every arg-th save (and the final one) a full image, the rest record just the 64x64 blocks of cells which changed since the save before (<name>(<generation>).delta), turned back into images by materialize. Keeps a copy of the grid in memory to compare against.")
+
+    (fmt(simulation::checkpoint_saves()).c_str(),
+      /* flag */ "Save binary checkpoints (<name>(<generation>).ckpt) instead of a state file and image, which hold the whole state in one file and load without parsing, dense grids without huge pages by mapping the file. Images, deltas and save threads don't apply.")
   ;
 
   return description;
@@ -309,7 +355,7 @@ options_description po::simulate_one_options_description()
       value<string>(), "Name of simulation, if unspecified state_file_path filename is used.")
 
     (fmt(simulate_one::state_file_path()).c_str(),
-      value<string>(), "JSON file containing initial state.")
+      value<string>(), "JSON file or checkpoint (.ckpt) containing initial state.")
 
     (fmt(simulate_one::log_file_path()).c_str(),
       value<string>(), "Log file path.")
@@ -336,8 +382,14 @@ options_description po::simulate_many_options_description()
     (fmt(simulate_many::queue_size()).c_str(),
       value<u16>(), "Number of simulations per processing chunk.")
 
+    (fmt(simulate_many::batch_size()).c_str(),
+      value<u16>(), "Number of simulations per thread pool task, default 1 (or --interleave if given). Batches are stepped in lockstep up to their first save or the generation limit, only applies to the kernel engine without highway fast-forwarding.")
+
+    (fmt(simulate_many::interleave()).c_str(),
+      value<u32>(), "Number of simulations from a batch each thread steps at once, [1, 8], default 8. Stepping several ants at once overlaps their cache misses, which matters most for grids too big for cache.")
+
     (fmt(simulate_many::state_dir_path()).c_str(),
-      value<string>(), "Path to directory containing initial JSON state files.")
+      value<string>(), "Path to directory containing initial JSON state files and or checkpoints (.ckpt).")
 
     (fmt(simulate_many::log_file_path()).c_str(),
       value<string>(), "Log file path.")
@@ -547,9 +599,9 @@ void po::parse_make_states_options(
     auto const ant_col = get_required_option<i32>(opt_ac, vm, errors);
 
     if (grid_width.has_value() && ant_col.has_value()) {
-      if (grid_width.value() < 1 || grid_width.value() > std::numeric_limits<u16>::max()) {
-        errors.emplace_back(make_str("%s must be in range [1, %zu]",
-          opt_gw.to_string().c_str(), std::numeric_limits<u16>::max()));
+      if (grid_width.value() < 1 || grid_width.value() > simulation::MAX_GRID_DIM) {
+        errors.emplace_back(make_str("%s must be in range [1, %d]",
+          opt_gw.to_string().c_str(), simulation::MAX_GRID_DIM));
       } else if (!util::in_range_incl_excl<i32>(ant_col.value(), 0, grid_width.value())) {
         errors.emplace_back(make_str("%s must be on grid x-axis [0, %zu)",
           opt_ac.to_string().c_str(), grid_width.value()));
@@ -568,9 +620,9 @@ void po::parse_make_states_options(
     auto const ant_row = get_required_option<i32>(opt_ar, vm, errors);
 
     if (grid_height.has_value() && ant_row.has_value()) {
-      if (grid_height.value() < 1 || grid_height.value() > std::numeric_limits<u16>::max()) {
-        errors.emplace_back(make_str("%s must be in range [1, %zu]",
-          opt_gh.to_string().c_str(), std::numeric_limits<u16>::max()));
+      if (grid_height.value() < 1 || grid_height.value() > simulation::MAX_GRID_DIM) {
+        errors.emplace_back(make_str("%s must be in range [1, %d]",
+          opt_gh.to_string().c_str(), simulation::MAX_GRID_DIM));
       } else if (!util::in_range_incl_excl<i32>(ant_row.value(), 0, grid_height.value())) {
         errors.emplace_back(make_str("%s must be on grid y-axis [0, %zu)",
           opt_ar.to_string().c_str(), grid_height.value()));
@@ -615,8 +667,10 @@ void po::parse_make_image_options(
         out.format = pgm8::format::RAW;
       else if (format.value() == "plain")
         out.format = pgm8::format::PLAIN;
+      else if (format.value() == "compressed")
+        out.format = pgm8::format::COMPRESSED;
       else
-        errors.emplace_back(make_str("%s must be one of raw|plain",
+        errors.emplace_back(make_str("%s must be one of raw|plain|compressed",
           opt.to_string().c_str()));
     }
   }
@@ -779,13 +833,152 @@ void validate_and_set_simulation_options(
         out.image_format = pgm8::format::RAW;
       else if (image_format.value() == "plain")
         out.image_format = pgm8::format::PLAIN;
+      else if (image_format.value() == "compressed")
+        out.image_format = pgm8::format::COMPRESSED;
       else
-        errors.emplace_back(make_str("%s must be one of raw|plain",
+        errors.emplace_back(make_str("%s must be one of raw|plain|compressed",
           opt.to_string().c_str()));
     } else {
       out.image_format = pgm8::format::RAW;
     }
   }
+
+  {
+    option const opt = simulation::grid_layout();
+    auto const grid_layout = get_nonrequired_option<std::string>(opt, vm, errors);
+
+    if (grid_layout.has_value()) {
+      if (grid_layout.value() == "dense")
+        out.grid_layout = ::simulation::grid_layout::DENSE;
+      else if (grid_layout.value() == "bordered")
+        out.grid_layout = ::simulation::grid_layout::BORDERED;
+      else if (grid_layout.value() == "packed")
+        out.grid_layout = ::simulation::grid_layout::PACKED;
+      else if (grid_layout.value() == "tiled")
+        out.grid_layout = ::simulation::grid_layout::TILED;
+      else if (grid_layout.value() == "sparse")
+        out.grid_layout = ::simulation::grid_layout::SPARSE;
+      else
+        errors.emplace_back(make_str("%s must be one of dense|bordered|packed|tiled|sparse",
+          opt.to_string().c_str()));
+    } else {
+      out.grid_layout = ::simulation::grid_layout::DENSE;
+    }
+  }
+
+  {
+    option const opt = simulation::huge_pages();
+    auto const huge_pages = get_nonrequired_option<std::string>(opt, vm, errors);
+
+    if (huge_pages.has_value()) {
+      if (huge_pages.value() == "off")
+        out.huge_pages = ::simulation::huge_pages::OFF;
+      else if (huge_pages.value() == "thp")
+        out.huge_pages = ::simulation::huge_pages::THP;
+      else if (huge_pages.value() == "hugetlb")
+        out.huge_pages = ::simulation::huge_pages::HUGETLB;
+      else
+        errors.emplace_back(make_str("%s must be one of off|thp|hugetlb",
+          opt.to_string().c_str()));
+    } else {
+      out.huge_pages = ::simulation::huge_pages::OFF;
+    }
+  }
+
+  {
+    option const opt = simulation::engine();
+    auto const engine = get_nonrequired_option<std::string>(opt, vm, errors);
+
+    if (engine.has_value()) {
+      if (engine.value() == "kernel")
+        out.engine.engine = ::simulation::step_engine::KERNEL;
+      else if (engine.value() == "memo")
+        out.engine.engine = ::simulation::step_engine::MEMO;
+      else if (engine.value() == "window")
+        out.engine.engine = ::simulation::step_engine::WINDOW;
+      else
+        errors.emplace_back(make_str("%s must be one of kernel|memo|window",
+          opt.to_string().c_str()));
+    } else {
+      out.engine.engine = ::simulation::step_engine::KERNEL;
+    }
+  }
+
+  {
+    option const opt = simulation::memo_table_mib();
+    auto const memo_table_mib = get_nonrequired_option<u64>(opt, vm, errors);
+
+    if (memo_table_mib.has_value()) {
+      if (memo_table_mib.value() == 0)
+        errors.emplace_back(make_str("%s must be > 0", opt.to_string().c_str()));
+      else
+        out.engine.memo_table_bytes = memo_table_mib.value() * 1024 * 1024;
+    } else {
+      out.engine.memo_table_bytes = ::simulation::engine_options{}.memo_table_bytes;
+    }
+  }
+
+  {
+    b8 const fast_forward_highways = get_flag_option(simulation::fast_forward_highways(), vm);
+    out.engine.fast_forward_highways = fast_forward_highways;
+  }
+
+  {
+    b8 const live_grid_file = get_flag_option(simulation::live_grid_file(), vm);
+    out.engine.live_grid_file = live_grid_file;
+  }
+
+  {
+    b8 const checkpoint_saves = get_flag_option(simulation::checkpoint_saves(), vm);
+    out.engine.checkpoint_saves = checkpoint_saves;
+  }
+
+  {
+    option const opt = simulation::delta_saves();
+    auto const delta_saves = get_nonrequired_option<u64>(opt, vm, errors);
+
+    if (delta_saves.has_value()) {
+      if (delta_saves.value() == 0)
+        errors.emplace_back(make_str("%s must be > 0", opt.to_string().c_str()));
+      else
+        out.engine.keyframe_interval = delta_saves.value();
+    }
+  }
+
+  {
+    option const opt = simulation::grow_to();
+    auto const grow_to = get_nonrequired_option<u64>(opt, vm, errors);
+
+    if (grow_to.has_value()) {
+      if (grow_to.value() == 0 || grow_to.value() > u64(simulation::MAX_GRID_DIM))
+        errors.emplace_back(make_str("%s must be in range [1, %d]", opt.to_string().c_str(), simulation::MAX_GRID_DIM));
+      else
+        out.engine.max_grid_dim = i32(grow_to.value());
+    } else {
+      out.engine.max_grid_dim = 0;
+    }
+  }
+
+  {
+    option const opt = simulation::save_threads();
+    auto const save_threads = get_nonrequired_option<u64>(opt, vm, errors);
+    // compressing takes long enough to be worth keeping off the simulating thread
+    out.save_threads = save_threads.value_or(out.image_format == pgm8::format::COMPRESSED ? 1 : 0);
+  }
+
+  {
+    option const opt = simulation::save_buffer_mib();
+    auto const save_buffer_mib = get_nonrequired_option<u64>(opt, vm, errors);
+
+    if (save_buffer_mib.has_value()) {
+      if (save_buffer_mib.value() == 0)
+        errors.emplace_back(make_str("%s must be > 0", opt.to_string().c_str()));
+      else
+        out.save_buffer_bytes = save_buffer_mib.value() * 1024 * 1024;
+    } else {
+      out.save_buffer_bytes = u64(256) * 1024 * 1024;
+    }
+  }
 }
 
 void po::parse_simulate_one_options(
@@ -942,6 +1135,37 @@ void po::parse_simulate_many_options(
     }
   }
 
+  {
+    option const opt = simulate_many::interleave();
+    auto interleave = get_nonrequired_option<u32>(opt, vm, errors);
+
+    if (interleave.has_value()) {
+      if (interleave.value() < 1 || interleave.value() > ::simulation::MAX_LOCKSTEP_LANES)
+        errors.emplace_back(make_str("%s must be in range [1, %" PRIu32 "]",
+          opt.to_string().c_str(), ::simulation::MAX_LOCKSTEP_LANES));
+      else
+        out.interleave = u8(interleave.value());
+    } else {
+      out.interleave = u8(::simulation::MAX_LOCKSTEP_LANES);
+    }
+  }
+
+  {
+    option const opt = simulate_many::batch_size();
+    auto batch_size = get_nonrequired_option<u16>(opt, vm, errors);
+
+    if (batch_size.has_value()) {
+      if (batch_size.value() == 0)
+        errors.emplace_back(make_str("%s must be > 0", opt.to_string().c_str()));
+      else
+        out.batch_size = batch_size.value();
+    } else if (vm.count(simulate_many::interleave().full_name) > 0) {
+      out.batch_size = out.interleave;
+    } else {
+      out.batch_size = 1;
+    }
+  }
+
   {
     b8 const log_to_stdout = get_flag_option(simulate_many::log_to_stdout(), vm);
     out.log_to_stdout = log_to_stdout;
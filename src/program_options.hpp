@@ -10,6 +10,7 @@
 #include <boost/program_options.hpp>
 
 #include "pgm8.hpp"
+#include "simulation.hpp"
 #include "util.hpp"
 
 namespace po
@@ -73,6 +74,11 @@ namespace po
     u64 generation_limit;
     u64 save_interval;
     pgm8::format image_format;
+    simulation::grid_layout grid_layout;
+    simulation::huge_pages huge_pages;
+    simulation::engine_options engine;
+    u64 save_threads; // 0 means saves are made on the simulating thread
+    u64 save_buffer_bytes;
     b8 save_final_state;
     b8 create_logs;
     b8 save_image_only;
@@ -98,6 +104,8 @@ namespace po
     std::string log_file_path;
     u32 num_threads;
     u16 queue_size;
+    u16 batch_size;
+    u8 interleave;
     b8 log_to_stdout;
     simulation_options sim;
 
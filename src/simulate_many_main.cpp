@@ -64,6 +64,8 @@ try
       "  - Each queue slot requires " << sizeof(named_simulation) << " bytes for the duration of the program\n"
       "  - Each in-flight simulation (# determined by thread pool size) requires " << sizeof(named_simulation) << " bytes of storage\n"
       "     plus whatever the grid (image) requires, where each cell (pixel) occupies 1 byte\n"
+      "     (fill grids only take up the pages the ant has written to, unless bordered,\n"
+      "     with --grid_layout sparse 4 KiB per 64x64 block of cells the ant has visited)\n"
       "  - Each simulation requires " << sizeof(completed_simulation_t) << " bytes of storage for the duration of the program\n"
       "\n";
     std::cout << usage_msg.str();
@@ -88,7 +90,7 @@ try
 
   std::vector<fs::path> const state_files = fregex::find(
     s_options.state_dir_path.c_str(),
-    ".*\\.json",
+    ".*\\.(json|ckpt)",
     fregex::entry_type::regular_file);
 
   if (state_files.empty())
@@ -124,8 +126,16 @@ try
   for (u32 i = 0; i < t_pool.get_thread_count(); ++i)
     util::set_thread_priority_high(threads[i]);
 
+  // for writing saves while simulations carry on
+  simulation::start_save_threads(s_options.sim.save_threads, s_options.sim.save_buffer_bytes);
+
   time_point_t const start_time = util::current_time();
 
+  // images named by grid_state, decoded once however many states name them and
+  // dropped once the last of those has been parsed
+  simulation::seed_image_cache seed_images{};
+  simulation::count_seed_image_references(seed_images, state_files, fs::path(s_options.state_dir_path));
+
   // parse state files into initial simulation states and add them to the simulation_queue
   std::thread producer_thread([&]() {
 
@@ -138,10 +148,19 @@ try
 
         simulation::state state;
         try {
-          state = simulation::parse_state(
-            util::extract_txt_file_contents(path_str.c_str(), false),
-            fs::path(s_options.state_dir_path),
-            errors);
+          state = simulation::is_checkpoint(path_str)
+            ? simulation::load_checkpoint(
+              path_str,
+              errors,
+              s_options.sim.grid_layout,
+              s_options.sim.huge_pages)
+            : simulation::parse_state(
+              util::extract_txt_file_contents(path_str.c_str(), false),
+              fs::path(s_options.state_dir_path),
+              errors,
+              s_options.sim.grid_layout,
+              s_options.sim.huge_pages,
+              &seed_images);
 
           if (!errors.empty()) {
             if (s_options.any_logging_enabled()) {
@@ -174,6 +193,7 @@ try
         s_options.sim.save_final_state,
         s_options.any_logging_enabled(),
         s_options.sim.save_image_only,
+        s_options.sim.engine,
         &num_simulations_processed,
         total);
 
@@ -196,18 +216,74 @@ try
       }
     }
 
-    delete[] sim.state.grid;
+    simulation::free_grid(sim.state);
     ++num_simulations_processed;
   };
 
+  // steps a batch in lockstep up to where each simulation first stops, leaving
+  // one generation so that run arrives at the stop (and possibly the edge) itself
+  auto const batch_task = [&](std::vector<named_simulation> &batch, u64 const total) {
+    std::vector<simulation::state *> states;
+    std::vector<u64> max_steps;
+
+    for (auto &sim : batch) {
+      u64 const dist = simulation::generations_until_first_stop(
+        sim.state,
+        s_options.sim.generation_limit,
+        s_options.sim.save_points,
+        s_options.sim.save_interval);
+
+      states.push_back(&sim.state);
+      max_steps.push_back(dist > 0 ? dist - 1 : 0);
+    }
+
+    std::vector<u64> start_gens(states.size());
+    for (u64 i = 0; i < states.size(); ++i)
+      start_gens[i] = states[i]->generation;
+
+    time_point_t const start = util::current_time();
+    simulation::step_forward_lockstep(states, max_steps, s_options.interleave);
+    u64 const nanos = util::nanos_between(start, util::current_time());
+
+    // split the time between simulations according to how far each got
+    u64 total_gens = 0;
+    for (u64 i = 0; i < states.size(); ++i)
+      total_gens += states[i]->generation - start_gens[i];
+    for (u64 i = 0; i < states.size(); ++i) {
+      u64 const gens = states[i]->generation - start_gens[i];
+      if (total_gens > 0)
+        states[i]->nanos_spent_iterating += u64(f64(nanos) * (f64(gens) / f64(total_gens)));
+    }
+
+    for (auto &sim : batch)
+      simulation_task(sim, total);
+  };
+
+  b8 const lockstep = s_options.batch_size > 1 &&
+    s_options.sim.engine.engine == simulation::step_engine::KERNEL &&
+    !s_options.sim.engine.fast_forward_highways;
+
+  std::vector<named_simulation> batch{};
+
   // submit parsed simulation states to the thread pool for simulation as they arrive
   std::thread consumer_thread([&]() {
     for (u64 i = 0; i < state_files.size(); ++i) {
       sem_full.acquire();
       try {
         std::scoped_lock sim_q_lock(simulation_queue_mutex);
-        t_pool.push_task(simulation_task, std::move(simulation_queue.back()), state_files.size());
-        simulation_queue.pop_back();
+        if (lockstep) {
+          if (!simulation_queue.empty()) {
+            batch.push_back(std::move(simulation_queue.back()));
+            simulation_queue.pop_back();
+          }
+          if (!batch.empty() && (batch.size() == s_options.batch_size || i == state_files.size() - 1)) {
+            t_pool.push_task(batch_task, std::move(batch), state_files.size());
+            batch = {};
+          }
+        } else {
+          t_pool.push_task(simulation_task, std::move(simulation_queue.back()), state_files.size());
+          simulation_queue.pop_back();
+        }
       } catch (std::exception const &except) {
         logger::log(logger::event_type::ERROR, "%s", except.what());
       } catch (...) {
@@ -218,8 +294,12 @@ try
   });
 
   producer_thread.join();
+  // every grid is its own clone by now, any images left are those of states
+  // which failed to parse before getting to them
+  simulation::release_seed_images(seed_images);
   consumer_thread.join();
   t_pool.wait_for_tasks();
+  simulation::stop_save_threads();
 
   time_point_t const end_time = util::current_time();
 
@@ -58,10 +58,18 @@ try
       return 1;
     }
 
-    s_sim_state = simulation::parse_state(
-      util::extract_txt_file_contents(s_options.state_file_path, false),
-      std::filesystem::current_path(),
-      errors);
+    s_sim_state = simulation::is_checkpoint(s_options.state_file_path)
+      ? simulation::load_checkpoint(
+        s_options.state_file_path,
+        errors,
+        s_options.sim.grid_layout,
+        s_options.sim.huge_pages)
+      : simulation::parse_state(
+        util::extract_txt_file_contents(s_options.state_file_path, false),
+        std::filesystem::current_path(),
+        errors,
+        s_options.sim.grid_layout,
+        s_options.sim.huge_pages);
 
     if (!errors.empty()) {
       for (auto const &err : errors)
@@ -84,7 +92,14 @@ try
   std::mutex progress_sleep_mutex{};
   bool sim_finished = false;
 
+  simulation::start_save_threads(s_options.sim.save_threads, s_options.sim.save_buffer_bytes);
+
+  // held until the sim thread's priority is set, which fails once it has exited
+  std::unique_lock start_lock(progress_sleep_mutex);
+
   std::thread sim_thread([&] {
+    { std::lock_guard started(progress_sleep_mutex); }
+
     std::atomic<u64> num_simulations_processed(0);
 
     s_sim_run_result = simulation::run(
@@ -98,11 +113,12 @@ try
       s_options.sim.save_final_state,
       s_options.sim.create_logs,
       s_options.sim.save_image_only,
+      s_options.sim.engine,
       &num_simulations_processed,
       1
     );
 
-    delete[] s_sim_state.grid;
+    simulation::free_grid(s_sim_state);
 
     std::lock_guard sleep_lock(progress_sleep_mutex);
     sim_finished = true;
@@ -110,6 +126,7 @@ try
   });
 
   util::set_thread_priority_high(sim_thread);
+  start_lock.unlock();
 
   term::hide_cursor();
   std::atexit(term::unhide_cursor);
@@ -146,6 +163,7 @@ try
     }
   }
 
+  simulation::stop_save_threads();
   std::exit(0);
 }
 catch (std::exception const &except)
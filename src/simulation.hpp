@@ -4,6 +4,10 @@
 #include <array>
 #include <cinttypes>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <variant>
@@ -93,6 +97,90 @@ namespace simulation
     u64 nanos_spent_saving;
   };
 
+  // Side length of the square tiles a TILED grid is made of,
+  // 64x64 single byte cells make up one 4 KiB page.
+  u32 const GRID_TILE_DIM = 64;
+
+  // Largest grid_width or grid_height. Indices are 64-bit throughout, the cap
+  // keeps the table of a SPARSE grid's chunks (8 bytes per 64x64 cells) within
+  // a few GiB of address space.
+  i32 const MAX_GRID_DIM = i32(1) << 20;
+
+  // Side length of the square window of cells around the ant which window
+  // kernels step within, 64 KiB fits in L2 with room to spare.
+  u32 const WINDOW_DIM = 256;
+
+  // How the cells of a grid are arranged in memory.
+  enum class grid_layout : u8
+  {
+    // grid_width * grid_height cells, row by row.
+    DENSE = 0,
+    // Like DENSE, but surrounded by a 1 cell border of a shade no rule governs
+    // (the sentinel), so stepping off the grid can be detected by shade alone.
+    BORDERED,
+    // Like DENSE, but with 1, 2 or 4 bits per cell (bits_per_cell), lowest bits
+    // first, for rulesets with few enough shades. Cells are numbered like DENSE
+    // and packed across row boundaries, so only byte offsets differ.
+    PACKED,
+    // GRID_TILE_DIM x GRID_TILE_DIM tiles, each stored row by row, with the
+    // tiles themselves row by row, so moving north or south mostly stays in the
+    // same page rather than jumping a whole row ahead. Cells are numbered like
+    // DENSE, right and bottom tiles are padded out to full size.
+    TILED,
+    // Like TILED, but each tile (chunk) is allocated separately, the first time
+    // the ant writes to it. Until then it reads as a uniform fill shade, so a
+    // huge grid only costs as much memory as the ant has visited.
+    SPARSE,
+  };
+
+  // What's past the edges of a grid.
+  enum class grid_boundary : u8
+  {
+    // Nothing, stepping off the grid ends the simulation (or grows the grid).
+    EDGE = 0,
+    // The grid itself, wrapping around from each edge to the opposite one.
+    // Only for grids whose width and height are powers of 2, which are always
+    // DENSE so the next cell is found with masks alone.
+    TORUS,
+  };
+
+  // What backs the memory of a DENSE, PACKED or TILED grid. Huge (2 MiB) pages
+  // cover more of the grid per TLB entry, which matters once vertical moves
+  // are a whole row apart, but get backed by memory 2 MiB at a time.
+  enum class huge_pages : u8
+  {
+    // Regular pages only.
+    OFF = 0,
+    // Transparent huge pages, asked for with madvise, which the kernel hands
+    // out as it sees fit.
+    THP,
+    // Huge pages reserved up front (/proc/sys/vm/nr_hugepages), falling back to
+    // THP when there aren't enough of them.
+    HUGETLB,
+  };
+
+  // The chunks of a SPARSE grid, null until written to, row by row like the
+  // tiles of a TILED grid. The table of them is mapped like a DENSE grid, so a
+  // huge grid only pays for the parts of the table around committed chunks.
+  struct sparse_chunks
+  {
+    u8 **chunks;
+    u64 num_chunks;
+    std::vector<u64> committed; // which chunks aren't null, in no particular order
+    u8 fill_shade; // what null chunks read as
+  };
+
+  // A DENSE grid kept in a raw PGM file, see `map_grid_to_file`.
+  struct grid_file
+  {
+    std::filesystem::path path;
+    u8 *mapping; // the whole file, header included
+    u64 num_bytes;
+    i32 fd;
+    // the file became a save's image, so it stays when the grid is freed
+    b8 handed_over;
+  };
+
   struct state
   {
     u64 start_generation;
@@ -101,7 +189,9 @@ namespace simulation
     u64 nanos_spent_saving;
     util::time_point_t activity_start;
     util::time_point_t activity_end;
-    u8 *grid;
+    u8 *grid; // null when layout is SPARSE
+    sparse_chunks *sparse; // only meaningful when layout is SPARSE
+    grid_file *file; // only set for grids mapped by map_grid_to_file
     i32 grid_width;
     i32 grid_height;
     i32 ant_col;
@@ -110,22 +200,391 @@ namespace simulation
     orientation::value_type ant_orientation;
     step_result::value_type last_step_res;
     u8 maxval;
+    grid_layout layout;
+    u8 sentinel_shade; // only meaningful when layout is BORDERED
+    u8 bits_per_cell; // 8 unless layout is PACKED
+    u8 shade_remap; // cells hold shade ^ shade_remap, see fill_grid
+    huge_pages grid_pages; // what the grid actually got, see allocate_grid
+    grid_boundary boundary;
+    u8 background_shade; // what grow_grid fills new cells with
+    // where cell (0, 0) of the grid the simulation started on is now, having
+    // been moved by grow_grid
+    i32 origin_col;
+    i32 origin_row;
     rules_t rules;
 
     b8 can_step_forward(u64 generation_limit = 0) const noexcept;
     u64 num_pixels() const noexcept;
+    // Distance in memory between vertically adjacent cells.
+    i32 grid_stride() const noexcept;
+    // Shade of the cell `idx` (row * grid_stride() + col), regardless of layout
+    // or shade_remap.
+    u8 get_cell(u64 idx) const noexcept;
+    void set_cell(u64 idx, u8 shade);
+    // Memory currently taken up by the grid, for SPARSE grids only committed
+    // chunks (and their entries in the table of them) count.
+    u64 grid_bytes() const noexcept;
+    // Memory taken up by the grid which is actually backed by physical pages,
+    // which for a fresh DENSE, PACKED or TILED grid is only what the ant has
+    // written to.
+    u64 grid_resident_bytes() const;
     u64 generations_completed() const noexcept;
     activity_time_breakdown query_activity_time_breakdown(util::time_point_t now = util::current_time());
     f64 compute_mega_gens_per_sec();
   };
 
+  // Allocates cells for `state.grid` according to `layout`, which also becomes
+  // `state.layout`. Rules must already be set, as BORDERED needs a shade without
+  // a governing rule for its border and falls back to DENSE when all 256 are
+  // taken. PACKED picks the fewest bits per cell that fit the highest ruled
+  // shade, falling back to DENSE past 4 bits. DENSE, PACKED and TILED grids are
+  // mapped straight from the OS and start out all shade 0, with pages only
+  // backed by memory once written to. SPARSE chunks are page aligned, SPARSE
+  // grids start out all null chunks filled with shade 0. BORDERED cells are
+  // uninitialized. Mapped grids are backed by `pages` if possible, falling back
+  // to the next best thing, which ends up in `state.grid_pages`. Returns false
+  // if the allocation failed.
+  b8 allocate_grid(state &state, grid_layout layout, huge_pages pages = huge_pages::OFF);
+
+  // Sets every cell of the grid (but not the border) to `shade`. SPARSE grids
+  // release all their chunks instead, and mapped grids hand their pages back and
+  // remap shades so that `shade` is stored as 0, so no cell is touched either way.
+  void fill_grid(state &state, u8 shade);
+
+  // The cells of chunk `chunk` of a SPARSE grid, allocated and filled the first
+  // time it's asked for. Throws std::bad_alloc if that fails.
+  u8 *commit_chunk(sparse_chunks &sparse, u64 chunk);
+
+  // Releases the chunks of a SPARSE grid which have gone back to being all fill
+  // shade, returns how many.
+  u64 release_uniform_chunks(state &state);
+
+  // Copies the `width` x `height` block of cells whose top left cell is at
+  // (`col`, `row`) into `cells`, with rows `cells_stride` apart, one shade per
+  // byte as stored (see `state::shade_remap`), regardless of layout.
+  void load_cells(state const &state, u32 col, u32 row, u32 width, u32 height, u8 *cells, u64 cells_stride);
+
+  // The reverse of `load_cells`. Only runs of cells which differ from what the
+  // grid holds are written, so pages (and SPARSE chunks) which haven't changed
+  // are never touched.
+  void store_cells(state &state, u32 col, u32 row, u32 width, u32 height, u8 const *cells, u64 cells_stride);
+
+  // Releases a grid allocated by `allocate_grid`, or mapped by
+  // `map_grid_to_file`, which deletes its file unless it was handed over.
+  void free_grid(state &state);
+
+  // Moves the cells of a DENSE grid into a raw PGM file at `path` (with
+  // `state.maxval` in its header) mapped shared, so the file always holds the
+  // grid as it is and saves only have to copy it, see `save_grid_file`. Does
+  // nothing for a grid already mapped to a file which hasn't been handed over.
+  // Returns false and leaves the grid as it was for other layouts, or if the
+  // file couldn't be made.
+  b8 map_grid_to_file(state &state, std::filesystem::path const &path);
+
+  // Saves the image of a grid mapped by `map_grid_to_file` to `path` by
+  // cloning the file where the file system supports it, copying it otherwise.
+  // With `hand_over`, the file is renamed to `path` instead, after which the
+  // grid mustn't change until it's mapped to a new file.
+  b8 save_grid_file(state const &state, std::filesystem::path const &path, b8 hand_over);
+
+  // For a state which just hit the edge, replaces the grid with one up to twice
+  // as wide and tall (capped at `max_dim` cells a side) with the old one in the
+  // middle, but always at least a cell in from the side being stepped off, and
+  // `state.background_shade` around it, then takes the step off the
+  // old edge which `attempt_step_forward` held back. Same layout and pages as
+  // before. Returns false and leaves `state` as it was if the side the ant is
+  // facing can't grow, or the new grid couldn't be allocated.
+  b8 grow_grid(state &state, i32 max_dim);
+
+  // Checks `rules` are at least 2 which form a closed chain, as `parse_state`
+  // requires, adding an error for why not.
+  b8 validate_rules(rules_t const &rules, std::function<void(std::string &&)> const &add_err);
+
+  // The lowest shade in `shade_present` without a governing rule, or 256 if
+  // they all have one.
+  u64 first_unruled_shade(rules_t const &rules, std::array<b8, 256> const &shade_present);
+
+  // An image named by grid_state, decoded once, see `seed_image_cache`.
+  struct seed_image
+  {
+    pgm8::image_properties props;
+    std::array<b8, 256> shade_present;
+    u8 *pixels; // never written to once decoded
+    u64 num_bytes;
+    // on Linux, the memfd `pixels` is a shared mapping of, so grids can be
+    // private mappings of it, -1 for RAW images and elsewhere
+    i32 fd;
+    // RAW images aren't decoded, `pixels` points into their file mapped
+    pgm8::mapped_image raw;
+  };
+
+  // Images named by grid_state, keyed by path and modification time, for when
+  // many states start from the same one. Each is decoded (or for RAW images,
+  // mapped) once and grids are copy-on-write clones of it (or copied from it,
+  // for layouts other than DENSE and with huge pages), which stay valid after
+  // the image leaves the cache.
+  struct seed_image_cache
+  {
+    std::mutex mutex;
+    std::map<std::pair<std::string, std::filesystem::file_time_type>, seed_image> images;
+    // how many states yet to be parsed name each image (by canonical path), an
+    // image goes once it drops to 0, see `count_seed_image_references`. Images
+    // without a count stay until `release_seed_images`.
+    std::map<std::string, u64> pending_references;
+  };
+
+  // Counts the states in `state_files` (relative to whose `dir` grid_state is)
+  // naming each image, so the cache can drop images no state still to be
+  // parsed names, and only holds as many at once as states in flight need.
+  void count_seed_image_references(
+    seed_image_cache &cache,
+    std::vector<std::filesystem::path> const &state_files,
+    std::filesystem::path const &dir);
+
+  void release_seed_images(seed_image_cache &cache);
+
+  // With `seed_images`, an image named by grid_state comes from (and on a
+  // miss, goes into) the cache, otherwise it's read from its file.
   state parse_state(
     std::string const &json_str,
     std::filesystem::path const &dir,
-    util::errors_t &errors);
+    util::errors_t &errors,
+    grid_layout layout = grid_layout::DENSE,
+    huge_pages pages = huge_pages::OFF,
+    seed_image_cache *seed_images = nullptr);
+
+  // Binary checkpoints, <name>(<generation>).ckpt, hold a whole state in one
+  // file: a fixed size header (generation, ant, rules, dimensions, timings),
+  // then the cells as real shades, one byte each row by row, starting at
+  // CHECKPOINT_GRID_OFFSET so they can be mapped.
+  char const CHECKPOINT_EXTENSION[] = ".ckpt";
+  u64 const CHECKPOINT_GRID_OFFSET = 4096;
+
+  b8 is_checkpoint(std::filesystem::path const &path);
+
+  // Returns false (and removes what was written) if the checkpoint couldn't be
+  // written.
+  b8 save_checkpoint(state const &state, char const *name, std::filesystem::path const &dir);
+
+  // Like `parse_state`, for a checkpoint. A DENSE grid without huge pages is
+  // the file's cells mapped copy-on-write, so nothing is read until the ant gets
+  // to it, any other grid is allocated and copied into. The rules are validated
+  // as by `parse_state`, and checked against the shades the header says the
+  // cells hold (and, when copied, the cells themselves).
+  state load_checkpoint(
+    std::filesystem::path const &path,
+    util::errors_t &errors,
+    grid_layout layout = grid_layout::DENSE,
+    huge_pages pages = huge_pages::OFF);
 
   step_result::value_type attempt_step_forward(state &state);
 
+  // Everything that happens to the ant in one generation, precomputed for a
+  // given (shade, orientation) pair so stepping is a single table lookup.
+  struct transition
+  {
+    i32 idx_delta;
+    i8 col_delta;
+    i8 row_delta;
+    u8 replacement_shade;
+    u8 orientation_idx; // orientation after turning, minus orientation::NORTH
+  };
+
+  // make sure entries stay small enough for the whole table to live in L1
+  static_assert(sizeof(transition) == 8);
+
+  // Indexed by (shade << 2) | (orientation - orientation::NORTH).
+  typedef std::array<transition, 256 * 4> transition_table_t;
+
+  // Shades are looked up and replaced as stored, i.e. XORed with `shade_remap`.
+  transition_table_t compile_rules(rules_t const &rules, i32 grid_stride, u8 shade_remap = 0);
+
+  // A stepping loop specialized for properties of a ruleset and grid which are
+  // known before stepping begins, along with the data it was compiled against.
+  struct step_kernel
+  {
+    typedef u64 (*function_t)(state &, step_kernel const &, u64 max_steps);
+
+    function_t function;
+    char name[32];
+    i32 row_stride; // distance in memory between vertically adjacent cells, as the kernel steps them
+    u32 num_rules;
+    u32 width_shift; // log2(state.grid_width), only meaningful when it's a power of 2
+    u8 sentinel_shade; // only used by sentinel kernels
+    // bit N set means shade N turns right/doesn't turn, only used by cyclic kernels
+    u64 right_turn_mask;
+    u64 no_turn_mask;
+    function_t window_function; // only used by window kernels, steps within the window
+    transition_table_t transitions;
+  };
+
+  // Picks the most specialized kernel for `state`, based on the number of rules,
+  // whether they form the canonical cyclic chain (replace_with = (on + 1) % n),
+  // whether any of them don't turn, and whether grid_width is a power of 2.
+  // BORDERED grids always get a sentinel kernel, which does no bounds checks,
+  // PACKED grids get a kernel which unpacks and repacks cells as it goes and
+  // TILED/SPARSE grids get one which only checks bounds when leaving a tile.
+  // TORUS grids get a kernel which wraps around with masks, never stopping
+  // short of `max_steps`.
+  step_kernel select_step_kernel(state const &state);
+
+  // Picks a kernel which copies the WINDOW_DIM x WINDOW_DIM cells around the
+  // ant (fewer if the grid is smaller) into a scratch buffer, steps there with
+  // the kernel `select_step_kernel` would pick for a DENSE grid that size, and
+  // only goes back to the grid to write the window back and re-center it on
+  // the ant once it steps out. Works with any layout, since the grid is only
+  // ever accessed through `load_cells` and `store_cells`.
+  step_kernel select_window_kernel(state const &state);
+
+  // Performs up to `max_steps` generations with `kernel`, keeping the ant in
+  // registers and only writing it back to `state` once done. Has the same
+  // effect as calling `attempt_step_forward` in a loop, returns the number of
+  // generations completed.
+  u64 step_forward(state &state, step_kernel const &kernel, u64 max_steps);
+
+  // What `run` steps simulations with.
+  enum class step_engine : u8
+  {
+    // The kernel picked by `select_step_kernel`.
+    KERNEL = 0,
+    // Memoized excursions through tiles, see `step_forward_memoized`.
+    MEMO,
+    // The kernel picked by `select_window_kernel`.
+    WINDOW,
+  };
+
+  struct engine_options
+  {
+    step_engine engine = step_engine::KERNEL;
+    u64 memo_table_bytes = u64(64) * 1024 * 1024; // only used by step_engine::MEMO
+    b8 fast_forward_highways = false;
+    // grids the ant steps off grow up to this many cells a side, see `grow_grid`,
+    // 0 means never
+    i32 max_grid_dim = 0;
+    // DENSE grids saved as raw images are kept in a file next to their saves
+    // while running, see `map_grid_to_file`
+    b8 live_grid_file = false;
+    // saves other than every this many are deltas, see `save_state`, 0 means
+    // every save is a full image
+    u64 keyframe_interval = 0;
+    // saves are checkpoints instead of a state file and image, see
+    // `save_checkpoint`
+    b8 checkpoint_saves = false;
+  };
+
+  // The outcome of an ant entering a tile at `entry_pos` facing `entry_orient_idx`
+  // with the tile's cells being `cells_before`. It took `num_moves` steps within
+  // the tile, then a step at `exit_pos` which turned it to `exit_orient_idx` and
+  // pointed it out of the tile, leaving the tile's cells as `cells_after`.
+  // Positions are row * TILE_DIM + col within the tile.
+  struct memo_entry
+  {
+    static u32 const TILE_DIM = 8;
+    static u32 const TILE_CELLS = TILE_DIM * TILE_DIM;
+
+    std::array<u8, TILE_CELLS> cells_before;
+    std::array<u8, TILE_CELLS> cells_after;
+    u32 num_moves;
+    u8 entry_pos;
+    u8 entry_orient_idx;
+    u8 exit_pos;
+    u8 exit_orient_idx;
+    b8 occupied;
+  };
+
+  struct memo_stats
+  {
+    u64 lookups;
+    u64 hits;
+    u64 stores;
+    u64 kernel_steps; // generations handed to the kernel because memoizing wasn't paying off
+  };
+
+  // A direct-mapped cache of tile excursions for a single ruleset, newer entries
+  // replace older ones that hash to the same slot.
+  //
+  // Memoizing only pays off while the ant keeps repeating itself, so stepping
+  // alternates between timed windows of memoized excursions and bursts of the
+  // plain kernel. Whenever a window turns out slower than the last burst, the
+  // next burst is twice as long.
+  struct memo_table
+  {
+    std::vector<memo_entry> entries; // size is a power of 2
+    memo_stats stats;
+    f64 kernel_gens_per_ns;
+    u64 kernel_burst;
+    u64 kernel_steps_remaining;
+    u64 window_lookups;
+    u64 window_steps;
+    util::time_point_t window_start;
+
+    // Sizes the table to the largest power of 2 number of entries that fits
+    // within `max_bytes`, but at least 1.
+    explicit memo_table(u64 max_bytes);
+  };
+
+  // Like `step_forward`, but moves the ant a whole excursion through one of the
+  // grid's 8x8 tiles at a time, looking excursions up in `memo` before working
+  // them out and remembering new ones. `memo` must only ever be used with rules
+  // identical to those of `state`. Tiles cut short by the right or bottom edge
+  // of the grid are stepped through but never memoized.
+  u64 step_forward_memoized(state &state, step_kernel const &kernel, memo_table &memo, u64 max_steps);
+
+  // Watches for the ant settling into a highway: a sequence of steps repeating
+  // every `period` generations, shifted by (col_delta, row_delta) each time,
+  // over cells it hasn't visited before.
+  struct highway_tracker
+  {
+    struct step_record
+    {
+      i32 col;
+      i32 row;
+      u8 shade_read;
+      u8 orient_idx; // before turning
+    };
+
+    std::vector<step_record> history; // scratch space for detection
+    u64 steps_until_check;
+    u64 check_interval;
+
+    // the most recently detected highway
+    u32 period;
+    i32 col_delta;
+    i32 row_delta;
+
+    u64 num_fast_forwards;
+    u64 gens_fast_forwarded;
+
+    highway_tracker();
+  };
+
+  // Like `step_forward` (or `step_forward_memoized` if `memo` isn't null), but
+  // every so often records the ant's recent steps, and if they form a highway
+  // which provably keeps going, writes the cells it would leave behind directly
+  // into the grid and jumps the ant ahead by a whole number of periods. Whatever
+  // is left before the edge or `max_steps` is stepped, so the outcome is
+  // identical to stepping all the way.
+  u64 step_forward_fast_forwarding_highways(
+    state &state,
+    step_kernel const &kernel,
+    memo_table *memo,
+    highway_tracker &tracker,
+    u64 max_steps);
+
+  u32 const MAX_LOCKSTEP_LANES = 8;
+
+  // Steps each of `states` by up to the corresponding entry of `max_steps`,
+  // `num_lanes` at a time in lockstep so that their memory accesses overlap
+  // rather than each waiting on the one before, prefetching each ant's next
+  // cell while the others step. Unlike the other stepping functions, an ant
+  // about to step off its grid is left just before doing so, so whatever steps
+  // it next hits the edge exactly like it would have here. Only DENSE and
+  // BORDERED grids with edges are stepped, the rest are left as they are.
+  void step_forward_lockstep(
+    std::vector<state *> const &states,
+    std::vector<u64> const &max_steps,
+    u32 num_lanes = MAX_LOCKSTEP_LANES);
+
   u8 deduce_maxval_from_rules(rules_t const &rules);
 
   struct save_state_result
@@ -134,12 +593,80 @@ namespace simulation
     b8 image_write_success;
   };
 
+  // What delta saves are relative to, see `save_state`.
+  struct delta_base
+  {
+    std::vector<u8> cells; // as of the last save, row by row, empty before the first
+    i32 grid_width;
+    i32 grid_height;
+    u64 generation;
+    u64 num_deltas; // since the last full image
+    u64 keyframe_interval; // every this many saves is a full image
+  };
+
+  // Makes `base` a copy of the grid as it is.
+  void set_delta_base(state const &state, delta_base &base);
+
+  // Writes the GRID_TILE_DIM x GRID_TILE_DIM tiles which differ from `base` to
+  // `path` (see the README for the format), then brings `base` up to date.
+  // `base` must be of a grid the same size.
+  b8 write_delta(state const &state, delta_base &base, std::filesystem::path const &path);
+
+  struct delta_header
+  {
+    u32 grid_width;
+    u32 grid_height;
+    u64 generation;
+    u64 base_generation; // of the save it's relative to
+    u32 tile_dim;
+    u64 num_tiles;
+  };
+
+  // Both throw std::runtime_error if the file is malformed.
+  delta_header read_delta_header(std::ifstream &file);
+  // Overwrites the tiles of `cells` (grid_width x grid_height, row by row) with
+  // those of the delta, the rest of whose file `file` must be.
+  void apply_delta(std::ifstream &file, delta_header const &header, u8 *cells);
+
+  // Writes the image a delta save stands for next to it, as named by its state
+  // file, by applying it and the deltas before it to the last full image. An
+  // earlier materialization counts as a full image. NIL `fmt` keeps the format
+  // of the full image. Throws std::runtime_error if any file in the chain is
+  // missing or malformed. Returns the path of the image.
+  std::filesystem::path materialize_delta(std::filesystem::path const &delta_path, pgm8::format fmt);
+
+  // With `delta` and a full image less than `delta->keyframe_interval` saves
+  // ago, the image is a delta (<name>(<generation>).delta) against the previous
+  // save, while the state file still names the full image, which
+  // `materialize_delta` makes.
   save_state_result save_state(
     state const &state,
     const char *name,
     std::filesystem::path const &dir,
     pgm8::format img_fmt,
-    b8 image_only);
+    b8 image_only,
+    b8 final_save = false, // the grid doesn't change after a final save
+    delta_base *delta = nullptr);
+
+  // Starts `num_threads` threads which `run` hands its saves to, so stepping
+  // carries on as soon as the grid has been copied. Copies waiting to be
+  // written take up at most `max_buffer_bytes` between them, and whoever needs
+  // another one waits for room. Saves of grids bigger than that are still made
+  // on the simulating thread, as are all of them without save threads.
+  void start_save_threads(u64 num_threads, u64 max_buffer_bytes);
+  // Waits for every save already handed over, then stops the save threads.
+  void stop_save_threads();
+
+  // Copies `state` for a save thread to write, which calls `on_done` once it
+  // has. False when there are no save threads or the grid doesn't fit in
+  // their buffers, in which case nothing is saved.
+  b8 save_state_async(
+    state const &state,
+    std::string const &name,
+    std::filesystem::path const &dir,
+    pgm8::format img_fmt,
+    b8 image_only,
+    std::function<void (save_state_result)> on_done);
 
   bool print_state_json(
     std::ostream &os,
@@ -153,7 +680,10 @@ namespace simulation
     step_result::value_type last_step_res,
     orientation::value_type ant_orientation,
     u64 maxval_digits,
-    rules_t const &rules);
+    rules_t const &rules,
+    i32 origin_col = 0,
+    i32 origin_row = 0,
+    grid_boundary boundary = grid_boundary::EDGE);
 
   std::string extract_name_from_json_state_path(std::string const &);
 
@@ -171,6 +701,14 @@ namespace simulation
     code code = code::NIL;
   };
 
+  // How many generations `run` would step `state` before its first save or
+  // reaching `generation_limit`, given the same arguments.
+  u64 generations_until_first_stop(
+    state const &state,
+    u64 generation_limit,
+    std::vector<u64> save_points,
+    u64 save_interval);
+
   run_result run(
     state &state,
     std::string const &name,
@@ -182,6 +720,7 @@ namespace simulation
     b8 save_final_state,
     b8 create_logs,
     b8 save_image_only,
+    engine_options const &engine,
     std::atomic<u64> *num_simulations_processed,
     u64 total_num_of_simulations);
 }
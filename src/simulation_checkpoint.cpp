@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "platform.hpp"
+#include "simulation.hpp"
+
+#if ON_LINUX
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using util::errors_t;
+using util::make_str;
+
+static char const s_checkpoint_magic[8] { 'A', 'N', 'T', 'C', 'K', 'P', 'T', '2' };
+
+// What a checkpoint starts with, the cells follow at `grid_offset`.
+struct checkpoint_header
+{
+  char magic[8];
+  u64 generation;
+  // time the run which saved the checkpoint had spent on it, informational
+  u64 nanos_spent_iterating;
+  u64 nanos_spent_saving;
+  u64 grid_offset;
+  i32 grid_width;
+  i32 grid_height;
+  i32 ant_col;
+  i32 ant_row;
+  i32 origin_col;
+  i32 origin_row;
+  simulation::orientation::value_type ant_orientation;
+  simulation::step_result::value_type last_step_res;
+  u8 boundary;
+  u8 background_shade;
+  u8 padding[4];
+  struct
+  {
+    u8 replacement_shade;
+    simulation::turn_direction::value_type turn_dir;
+  } rules[256];
+  // bit `shade % 8` of byte `shade / 8` is set if any cell has that shade, so
+  // the cells can be checked against the rules without reading them all
+  u8 shades_present[32];
+};
+
+static_assert(sizeof(checkpoint_header) == 616);
+static_assert(sizeof(checkpoint_header) <= simulation::CHECKPOINT_GRID_OFFSET);
+
+b8 simulation::is_checkpoint(fs::path const &path)
+{
+  return path.extension() == CHECKPOINT_EXTENSION;
+}
+
+b8 simulation::save_checkpoint(state const &state, char const *const name, fs::path const &dir)
+{
+  if (!fs::is_directory(dir)) {
+    throw std::runtime_error(make_str("save_dir '%s' is not a directory", dir.generic_string().c_str()));
+  }
+
+  checkpoint_header header{};
+  std::memcpy(header.magic, s_checkpoint_magic, sizeof(header.magic));
+  header.generation = state.generation;
+  header.nanos_spent_iterating = state.nanos_spent_iterating;
+  header.nanos_spent_saving = state.nanos_spent_saving;
+  header.grid_offset = CHECKPOINT_GRID_OFFSET;
+  header.grid_width = state.grid_width;
+  header.grid_height = state.grid_height;
+  header.ant_col = state.ant_col;
+  header.ant_row = state.ant_row;
+  header.origin_col = state.origin_col;
+  header.origin_row = state.origin_row;
+  header.ant_orientation = state.ant_orientation;
+  header.last_step_res = state.last_step_res;
+  header.boundary = u8(state.boundary);
+  header.background_shade = state.background_shade;
+  for (u64 shade = 0; shade < state.rules.size(); ++shade) {
+    header.rules[shade].replacement_shade = state.rules[shade].replacement_shade;
+    header.rules[shade].turn_dir = state.rules[shade].turn_dir;
+  }
+
+  // written beside the checkpoint and renamed over it, as a grid may be a
+  // private mapping of it, see `load_checkpoint`, which truncating it would pull
+  // out from under
+  fs::path const path = dir / make_str("%s(%zu)%s", name, state.generation, CHECKPOINT_EXTENSION);
+  fs::path const tmp_path = path.string() + ".tmp";
+  std::fstream file = util::open_file(tmp_path.string(), std::ios::out | std::ios::binary);
+
+  // the header goes in once the cells have been seen
+  std::vector<char> padding(CHECKPOINT_GRID_OFFSET, 0);
+  file.write(padding.data(), std::streamsize(padding.size()));
+
+  // real shades, a band of rows at a time
+  u64 const width = u64(state.grid_width);
+  u64 const band_rows = std::max(u64(1), (u64(1) << 20) / width);
+  std::vector<u8> band(width * std::min(band_rows, u64(state.grid_height)));
+
+  for (u64 row = 0; row < u64(state.grid_height) && file; row += band_rows) {
+    u64 const num_rows = std::min(band_rows, u64(state.grid_height) - row);
+    u64 const num_cells = num_rows * width;
+    load_cells(state, 0, u32(row), u32(width), u32(num_rows), band.data(), width);
+    if (state.shade_remap != 0) {
+      for (u64 i = 0; i < num_cells; ++i)
+        band[i] ^= state.shade_remap;
+    }
+    for (u64 i = 0; i < num_cells; ++i)
+      header.shades_present[band[i] / 8] |= u8(1 << (band[i] % 8));
+    file.write(reinterpret_cast<char const *>(band.data()), std::streamsize(num_cells));
+  }
+
+  file.seekp(0);
+  file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+  file.close();
+  std::error_code ec;
+  if (file)
+    fs::rename(tmp_path, path, ec);
+  if (!file || ec) {
+    fs::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+simulation::state simulation::load_checkpoint(
+  fs::path const &path,
+  errors_t &errors,
+  grid_layout const layout,
+  huge_pages const pages)
+{
+  std::string const path_str = path.generic_string();
+  u64 const num_prior_errors = errors.size();
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    errors.emplace_back(make_str("unable to open file \"%s\"", path_str.c_str()));
+    return {};
+  }
+
+  checkpoint_header header{};
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!file || std::memcmp(header.magic, s_checkpoint_magic, sizeof(header.magic)) != 0) {
+    errors.emplace_back(make_str("\"%s\" is not a checkpoint", path_str.c_str()));
+    return {};
+  }
+
+  if (header.grid_width < 1 || header.grid_width > MAX_GRID_DIM || header.grid_height < 1 || header.grid_height > MAX_GRID_DIM)
+    errors.emplace_back(make_str("bad grid dimensions %dx%d", header.grid_width, header.grid_height));
+  else if (!util::in_range_incl_excl(header.ant_col, 0, header.grid_width) || !util::in_range_incl_excl(header.ant_row, 0, header.grid_height))
+    errors.emplace_back(make_str("bad ant position (%d, %d)", header.ant_col, header.ant_row));
+  else if (header.grid_offset < sizeof(header)
+    || fs::file_size(path) < header.grid_offset + (u64(header.grid_width) * u64(header.grid_height)))
+    errors.emplace_back("truncated grid");
+
+  if (header.ant_orientation < orientation::NORTH || header.ant_orientation > orientation::WEST)
+    errors.emplace_back("bad ant_orientation");
+  if (header.last_step_res < step_result::NIL || header.last_step_res > step_result::HIT_EDGE)
+    errors.emplace_back("bad last_step_result");
+  if (header.boundary > u8(grid_boundary::TORUS))
+    errors.emplace_back("bad boundary");
+  else if (header.boundary == u8(grid_boundary::TORUS)
+    && (!std::has_single_bit(u32(header.grid_width)) || !std::has_single_bit(u32(header.grid_height))))
+    errors.emplace_back("bad boundary, torus grid_width and grid_height must be powers of 2");
+
+  // the rules have to hold together as they do for `parse_state`, and govern
+  // every shade the cells were saved with
+  state state{};
+  b8 rules_decoded = true;
+  for (u64 shade = 0; shade < state.rules.size(); ++shade) {
+    auto const &rule = header.rules[shade];
+    if (rule.turn_dir != turn_direction::NIL && (rule.turn_dir < turn_direction::LEFT || rule.turn_dir > turn_direction::RIGHT)) {
+      errors.emplace_back(make_str("bad rule for shade %zu", shade));
+      rules_decoded = false;
+    }
+    state.rules[shade] = { rule.replacement_shade, rule.turn_dir };
+  }
+
+  if (rules_decoded && validate_rules(state.rules, [&errors](std::string &&err) { errors.emplace_back(std::move(err)); })) {
+    std::array<b8, 256> shade_present{};
+    for (u64 shade = 0; shade < shade_present.size(); ++shade)
+      shade_present[shade] = (header.shades_present[shade / 8] >> (shade % 8)) & 1;
+    u64 const shade = first_unruled_shade(state.rules, shade_present);
+    if (shade < shade_present.size())
+      errors.emplace_back(make_str("shade %zu in the grid has no governing rule", shade));
+  }
+
+  if (errors.size() > num_prior_errors) {
+    for (auto err = errors.begin() + i64(num_prior_errors); err != errors.end(); ++err)
+      *err = make_str("failed to load \"%s\" - %s", path_str.c_str(), err->c_str());
+    return {};
+  }
+
+  state.generation = header.generation;
+  state.start_generation = header.generation;
+  state.grid_width = header.grid_width;
+  state.grid_height = header.grid_height;
+  state.ant_col = header.ant_col;
+  state.ant_row = header.ant_row;
+  state.origin_col = header.origin_col;
+  state.origin_row = header.origin_row;
+  state.ant_orientation = header.ant_orientation;
+  state.last_step_res = header.last_step_res;
+  state.boundary = grid_boundary(header.boundary);
+  state.background_shade = header.background_shade;
+
+  // a torus wraps around row by row, which only DENSE grids are laid out as
+  grid_layout const state_layout = state.boundary == grid_boundary::TORUS ? grid_layout::DENSE : layout;
+
+#if ON_LINUX
+  // the cells are laid out just like a DENSE grid, so such a grid can be the
+  // file itself, mapped copy-on-write and only read as the ant gets to it
+  if (state_layout == grid_layout::DENSE && pages == huge_pages::OFF
+    && header.grid_offset % u64(sysconf(_SC_PAGESIZE)) == 0)
+  {
+    i32 const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    void *const addr = fd < 0
+      ? MAP_FAILED
+      : mmap(nullptr, state.num_pixels(), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, off_t(header.grid_offset));
+    if (fd >= 0)
+      close(fd); // the mapping keeps the file open
+
+    if (addr != MAP_FAILED) {
+      state.layout = grid_layout::DENSE;
+      state.bits_per_cell = 8;
+      state.shade_remap = 0;
+      state.grid_pages = huge_pages::OFF;
+      state.file = nullptr;
+      state.grid = static_cast<u8 *>(addr);
+      return state;
+    }
+  }
+#endif
+
+  if (!allocate_grid(state, state_layout, pages)) {
+    errors.emplace_back(make_str("unable to allocate %zu bytes for grid", state.num_pixels()));
+    return {};
+  }
+  fill_grid(state, state.background_shade);
+
+  // anything else gets a copy, a band of rows at a time
+  u64 const width = u64(state.grid_width);
+  u64 const band_rows = std::max(u64(1), (u64(1) << 20) / width);
+  std::vector<u8> band(width * std::min(band_rows, u64(state.grid_height)));
+
+  file.seekg(std::streamoff(header.grid_offset));
+  try {
+    for (u64 row = 0; row < u64(state.grid_height); row += band_rows) {
+      u64 const num_rows = std::min(band_rows, u64(state.grid_height) - row);
+      file.read(reinterpret_cast<char *>(band.data()), std::streamsize(num_rows * width));
+      if (!file)
+        throw std::runtime_error("unexpected end of file");
+      // the header could be wrong about the shades, the cells are at hand anyway
+      for (u64 i = 0; i < num_rows * width; ++i)
+        if (state.rules[band[i]].turn_dir == turn_direction::NIL)
+          throw std::runtime_error(make_str("shade %u in the grid has no governing rule", u32(band[i])));
+      if (state.shade_remap != 0) {
+        for (u64 i = 0; i < num_rows * width; ++i)
+          band[i] ^= state.shade_remap;
+      }
+      store_cells(state, 0, u32(row), u32(width), u32(num_rows), band.data(), width);
+    }
+  } catch (std::exception const &except) {
+    errors.emplace_back(make_str("failed to load \"%s\" - %s", path_str.c_str(), except.what()));
+    free_grid(state);
+    return {};
+  }
+
+  return state;
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <regex>
+
+#include "simulation.hpp"
+
+namespace fs = std::filesystem;
+using util::make_str;
+
+static char const s_delta_magic[] = "ANTDELTA";
+
+void simulation::set_delta_base(state const &state, delta_base &base)
+{
+  u32 const width = u32(state.grid_width);
+  base.cells.resize(state.num_pixels());
+  load_cells(state, 0, 0, width, u32(state.grid_height), base.cells.data(), width);
+  if (state.shade_remap != 0) {
+    for (u8 &cell : base.cells)
+      cell ^= state.shade_remap;
+  }
+  base.grid_width = state.grid_width;
+  base.grid_height = state.grid_height;
+  base.generation = state.generation;
+  base.num_deltas = 0;
+}
+
+b8 simulation::write_delta(state const &state, delta_base &base, fs::path const &path)
+{
+  u64 const dim = GRID_TILE_DIM;
+  u64 const width = u64(state.grid_width);
+  u64 const height = u64(state.grid_height);
+  u64 const tiles_per_row = (width + dim - 1) / dim;
+
+  // one row of tiles at a time, compared against the last save and copied over
+  // it where they differ
+  std::vector<u8> band(width * dim);
+  std::vector<u64> dirty_tiles{};
+
+  for (u64 band_row = 0; band_row < height; band_row += dim) {
+    u64 const band_height = std::min(dim, height - band_row);
+    load_cells(state, 0, u32(band_row), u32(width), u32(band_height), band.data(), width);
+    if (state.shade_remap != 0) {
+      for (u64 i = 0; i < band_height * width; ++i)
+        band[i] ^= state.shade_remap;
+    }
+
+    for (u64 col = 0; col < width; col += dim) {
+      u64 const tile_width = std::min(dim, width - col);
+      b8 dirty = false;
+      for (u64 r = 0; r < band_height && !dirty; ++r)
+        dirty = std::memcmp(band.data() + (r * width) + col, base.cells.data() + ((band_row + r) * width) + col, tile_width) != 0;
+      if (!dirty)
+        continue;
+
+      for (u64 r = 0; r < band_height; ++r)
+        std::memcpy(base.cells.data() + ((band_row + r) * width) + col, band.data() + (r * width) + col, tile_width);
+      dirty_tiles.push_back(((band_row / dim) * tiles_per_row) + (col / dim));
+    }
+  }
+
+  std::fstream file = util::open_file(path.string(), std::ios::out | std::ios::binary);
+
+  file
+    << s_delta_magic << '\n'
+    << width << ' ' << height << '\n'
+    << state.generation << ' ' << base.generation << '\n'
+    << dim << ' ' << dirty_tiles.size() << '\n';
+
+  for (u64 const tile : dirty_tiles) {
+    u64 const col = (tile % tiles_per_row) * dim;
+    u64 const row = (tile / tiles_per_row) * dim;
+    u32 const position[2] { u32(col / dim), u32(row / dim) };
+    file.write(reinterpret_cast<char const *>(position), sizeof(position));
+
+    u64 const tile_width = std::min(dim, width - col);
+    for (u64 r = row; r < std::min(row + dim, height); ++r)
+      file.write(reinterpret_cast<char const *>(base.cells.data() + (r * width) + col), std::streamsize(tile_width));
+  }
+
+  base.generation = state.generation;
+  return !file.bad();
+}
+
+simulation::delta_header simulation::read_delta_header(std::ifstream &file)
+{
+  std::string magic{};
+  std::getline(file, magic);
+  if (magic != s_delta_magic)
+    throw std::runtime_error("invalid magic number, corrupt or non-delta file");
+
+  delta_header header{};
+  file
+    >> header.grid_width >> header.grid_height
+    >> header.generation >> header.base_generation
+    >> header.tile_dim >> header.num_tiles;
+
+  if (!file || header.grid_width == 0 || header.grid_height == 0 || header.tile_dim == 0)
+    throw std::runtime_error("invalid header");
+
+  // eat the \n between the header and the tiles
+  file.get();
+
+  return header;
+}
+
+void simulation::apply_delta(std::ifstream &file, delta_header const &header, u8 *const cells)
+{
+  u64 const dim = header.tile_dim;
+  u64 const width = header.grid_width;
+  u64 const height = header.grid_height;
+
+  for (u64 i = 0; i < header.num_tiles; ++i) {
+    u32 position[2];
+    file.read(reinterpret_cast<char *>(position), sizeof(position));
+
+    u64 const col = u64(position[0]) * dim;
+    u64 const row = u64(position[1]) * dim;
+    if (!file || col >= width || row >= height)
+      throw std::runtime_error(make_str("bad tile %zu", i));
+
+    u64 const tile_width = std::min(dim, width - col);
+    for (u64 r = row; r < std::min(row + dim, height); ++r)
+      file.read(reinterpret_cast<char *>(cells + (r * width) + col), std::streamsize(tile_width));
+
+    if (!file)
+      throw std::runtime_error(make_str("unexpected end of file in tile %zu", i));
+  }
+}
+
+fs::path simulation::materialize_delta(fs::path const &delta_path, pgm8::format fmt)
+{
+  std::smatch match;
+  std::string const filename = delta_path.filename().string();
+  if (!std::regex_match(filename, match, std::regex(R"(^(.+)\(([0-9]+)\)\.delta$)")))
+    throw std::runtime_error(make_str("'%s' isn't named like a delta save, <name>(<generation>).delta", filename.c_str()));
+
+  std::string const name = match[1].str();
+  fs::path const dir = delta_path.parent_path();
+  auto const save_path = [&](u64 const generation, char const *const extension) {
+    return dir / make_str("%s(%zu)%s", name.c_str(), generation, extension);
+  };
+
+  // back through the deltas to the last full image, which an earlier
+  // materialization counts as too
+  std::vector<std::pair<fs::path, delta_header>> deltas{};
+  fs::path keyframe_path = delta_path;
+  for (;;) {
+    std::ifstream file(keyframe_path, std::ios::binary);
+    if (!file)
+      throw std::runtime_error(make_str("unable to open '%s'", keyframe_path.string().c_str()));
+    delta_header const header = read_delta_header(file);
+    deltas.emplace_back(keyframe_path, header);
+
+    keyframe_path = save_path(header.base_generation, ".pgm");
+    if (fs::exists(keyframe_path))
+      break;
+    keyframe_path = save_path(header.base_generation, ".pgmz");
+    if (fs::exists(keyframe_path))
+      break;
+    keyframe_path = save_path(header.base_generation, ".delta");
+    if (!fs::exists(keyframe_path))
+      throw std::runtime_error(make_str("none of '%s', '%s' and '%s' exist",
+        save_path(header.base_generation, ".pgm").string().c_str(),
+        save_path(header.base_generation, ".pgmz").string().c_str(),
+        keyframe_path.string().c_str()));
+  }
+
+  std::ifstream keyframe(keyframe_path, std::ios::binary);
+  pgm8::image_properties props = pgm8::read_properties(keyframe);
+  delta_header const &newest = deltas.front().second;
+  if (props.get_width() != newest.grid_width || props.get_height() != newest.grid_height)
+    throw std::runtime_error(make_str("'%s' is %" PRIu32 "x%" PRIu32 ", the deltas are %" PRIu32 "x%" PRIu32,
+      keyframe_path.string().c_str(), props.get_width(), props.get_height(), newest.grid_width, newest.grid_height));
+
+  std::vector<u8> cells(props.num_pixels());
+  pgm8::read_pixels(keyframe, props, cells.data());
+
+  for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) {
+    std::ifstream file(it->first, std::ios::binary);
+    delta_header const header = read_delta_header(file);
+    if (header.grid_width != newest.grid_width || header.grid_height != newest.grid_height)
+      throw std::runtime_error(make_str("'%s' is for a grid of a different size", it->first.string().c_str()));
+    apply_delta(file, header, cells.data());
+  }
+
+  if (fmt != pgm8::format::NIL)
+    props.set_format(fmt);
+
+  fs::path const out_path = save_path(newest.generation, pgm8::file_extension(props.get_format()));
+  std::fstream out = util::open_file(out_path.string(), std::ios::out | std::ios::binary);
+  if (!pgm8::write(out, props, cells.data()))
+    throw std::runtime_error(make_str("failed to write '%s'", out_path.string().c_str()));
+
+  return out_path;
+}
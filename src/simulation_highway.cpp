@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "simulation.hpp"
+
+using simulation::highway_tracker;
+
+// How many steps are recorded for each detection attempt. A highway is only
+// recognized once enough of its periods fit in here to prove it keeps going.
+static u64 const s_history_len = 1 << 14;
+
+// Bounds on the number of generations between detection attempts, the interval
+// doubles after every attempt that doesn't find a highway.
+static u64 const s_min_check_interval = 1 << 16;
+static u64 const s_max_check_interval = 1 << 28;
+
+// Jumps shorter than this aren't worth the bookkeeping.
+static u64 const s_min_fast_forward_gens = 1 << 12;
+
+simulation::highway_tracker::highway_tracker()
+  : history{},
+    steps_until_check{s_min_check_interval},
+    check_interval{s_min_check_interval},
+    period{0},
+    col_delta{0},
+    row_delta{0},
+    num_fast_forwards{0},
+    gens_fast_forwarded{0}
+{}
+
+// Steps like `attempt_step_forward`, but appends what each step read to `history`.
+static
+u64 record_steps(
+  simulation::state &state,
+  simulation::step_kernel const &kernel,
+  std::vector<highway_tracker::step_record> &history,
+  u64 const max_steps)
+{
+  using namespace simulation;
+
+  u64 const stride = u64(state.grid_stride());
+  u32 const width = u32(state.grid_width);
+  u32 const height = u32(state.grid_height);
+
+  u32 col = u32(state.ant_col);
+  u32 row = u32(state.ant_row);
+  u32 orient_idx = u32(state.ant_orientation - orientation::NORTH);
+
+  u64 steps_taken = 0;
+  b8 hit_edge = false;
+
+  for (; steps_taken < max_steps; ++steps_taken) {
+    u64 const idx = (u64(row) * stride) + col;
+    u8 const shade = state.get_cell(idx);
+    // the kernel's table works on shades as stored
+    transition const t = kernel.transitions[(u32(shade ^ state.shade_remap) << 2) | orient_idx];
+
+    history.push_back({ i32(col), i32(row), shade, u8(orient_idx) });
+
+    state.set_cell(idx, u8(t.replacement_shade ^ state.shade_remap));
+    orient_idx = t.orientation_idx;
+
+    u32 const next_col = col + u32(i32(t.col_delta));
+    u32 const next_row = row + u32(i32(t.row_delta));
+
+    if (next_col >= width || next_row >= height) {
+      hit_edge = true;
+      break;
+    }
+
+    col = next_col;
+    row = next_row;
+  }
+
+  state.ant_col = i32(col);
+  state.ant_row = i32(row);
+  state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+  state.generation += steps_taken;
+
+  if (hit_edge)
+    state.last_step_res = step_result::HIT_EDGE;
+  else if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
+
+struct pattern_step
+{
+  i32 col_offset; // relative to where the ant is at the start of a period
+  i32 row_offset;
+  u8 shade_read;
+  u8 shade_written;
+};
+
+// One period of a highway, along with what's needed to extrapolate it.
+struct highway_pattern
+{
+  std::vector<pattern_step> steps;
+  // steps which visit a cell for the first time, what they read has to come
+  // from the untouched grid ahead
+  std::vector<u32> first_visits;
+  // steps which visit a cell for the last time, what they write is final
+  std::vector<u32> last_visits;
+  i32 col_delta;
+  i32 row_delta;
+  i32 min_col_offset, max_col_offset;
+  i32 min_row_offset, max_row_offset;
+  // the furthest number of periods apart two visits to the same cell can be
+  u32 max_revisit_periods;
+};
+
+static
+u64 pack_offset(i32 const col_offset, i32 const row_offset)
+{
+  return (u64(u32(col_offset)) << 32) | u32(row_offset);
+}
+
+// Works out which cells steps revisit. Returns false if that can't be bounded,
+// which is the case for an ant going around in circles (col_delta and
+// row_delta both 0).
+static
+b8 analyze_pattern(highway_pattern &pat)
+{
+  if (pat.col_delta == 0 && pat.row_delta == 0)
+    return false;
+
+  // first and last step visiting each cell within the period
+  std::unordered_map<u64, std::pair<u32, u32>> visits;
+  visits.reserve(pat.steps.size());
+
+  pat.min_col_offset = pat.max_col_offset = 0;
+  pat.min_row_offset = pat.max_row_offset = 0;
+
+  for (u32 i = 0; i < pat.steps.size(); ++i) {
+    pattern_step const &step = pat.steps[i];
+    auto const [it, inserted] = visits.try_emplace(pack_offset(step.col_offset, step.row_offset), i, i);
+    if (!inserted)
+      it->second.second = i;
+
+    pat.min_col_offset = std::min(pat.min_col_offset, step.col_offset);
+    pat.max_col_offset = std::max(pat.max_col_offset, step.col_offset);
+    pat.min_row_offset = std::min(pat.min_row_offset, step.row_offset);
+    pat.max_row_offset = std::max(pat.max_row_offset, step.row_offset);
+  }
+
+  auto const in_footprint = [&](i32 const col_offset, i32 const row_offset) {
+    return
+      col_offset >= pat.min_col_offset && col_offset <= pat.max_col_offset &&
+      row_offset >= pat.min_row_offset && row_offset <= pat.max_row_offset;
+  };
+
+  pat.max_revisit_periods = 0;
+  pat.first_visits.clear();
+  pat.last_visits.clear();
+
+  for (u32 i = 0; i < pat.steps.size(); ++i) {
+    pattern_step const &step = pat.steps[i];
+    auto const &[first, last] = visits.at(pack_offset(step.col_offset, step.row_offset));
+
+    // the same cell is at offset + (m * delta) m periods earlier,
+    // and offset - (m * delta) m periods later
+    b8 visited_earlier = first != i;
+    for (i32 m = 1;; ++m) {
+      i32 const col = step.col_offset + (m * pat.col_delta);
+      i32 const row = step.row_offset + (m * pat.row_delta);
+      if (!in_footprint(col, row))
+        break;
+      if (visits.contains(pack_offset(col, row))) {
+        visited_earlier = true;
+        pat.max_revisit_periods = std::max(pat.max_revisit_periods, u32(m));
+      }
+    }
+
+    b8 visited_later = last != i;
+    for (i32 m = 1; !visited_later; ++m) {
+      i32 const col = step.col_offset - (m * pat.col_delta);
+      i32 const row = step.row_offset - (m * pat.row_delta);
+      if (!in_footprint(col, row))
+        break;
+      visited_later = visits.contains(pack_offset(col, row));
+    }
+
+    if (!visited_earlier)
+      pat.first_visits.push_back(i);
+    if (!visited_later)
+      pat.last_visits.push_back(i);
+  }
+
+  return true;
+}
+
+// Looks for the shortest period P such that the tail of `history` repeats every
+// P steps, shifted by the same displacement each time. Every period of the tail
+// behaves the same as long as each cell reads the same thing each time around,
+// which holds for cells revisited within the tail by induction, so it's enough
+// to see one more period than cells are revisited across, and then check the
+// first visits to come (see `fast_forward`).
+//
+// On success, `pat` holds the last period of the tail, which ends where the ant
+// is now.
+static
+b8 detect_highway(
+  std::vector<highway_tracker::step_record> const &history,
+  simulation::rules_t const &rules,
+  highway_pattern &pat)
+{
+  u64 const n = history.size();
+
+  for (u64 period = 1; period <= n / 2; ++period) {
+    auto const &last = history[n - 1];
+    auto const &prev = history[n - 1 - period];
+
+    if (last.shade_read != prev.shade_read || last.orient_idx != prev.orient_idx)
+      continue;
+
+    i32 const col_delta = last.col - prev.col;
+    i32 const row_delta = last.row - prev.row;
+
+    // find where the tail stops repeating
+    u64 t = n - 1;
+    while (t >= period) {
+      auto const &a = history[t];
+      auto const &b = history[t - period];
+      if (
+        a.shade_read != b.shade_read ||
+        a.orient_idx != b.orient_idx ||
+        a.col - b.col != col_delta ||
+        a.row - b.row != row_delta
+      ) {
+        break;
+      }
+      --t;
+    }
+
+    u64 const num_periods = (n - (t + 1 - period)) / period;
+    if (num_periods < 2)
+      continue;
+
+    u64 const start = n - period;
+    pat.col_delta = col_delta;
+    pat.row_delta = row_delta;
+    pat.steps.resize(period);
+    for (u64 i = 0; i < period; ++i) {
+      auto const &rec = history[start + i];
+      pat.steps[i] = {
+        rec.col - history[start].col,
+        rec.row - history[start].row,
+        rec.shade_read,
+        rules[rec.shade_read].replacement_shade,
+      };
+    }
+
+    if (!analyze_pattern(pat))
+      continue;
+
+    if (num_periods >= u64(pat.max_revisit_periods) + 1)
+      return true;
+  }
+
+  return false;
+}
+
+// Number of periods the ant can keep going from `pos` along an axis before the
+// highway's footprint would leave [0, dim).
+static
+u64 periods_within_bounds(i64 const pos, i64 const delta, i64 const min_offset, i64 const max_offset, i64 const dim)
+{
+  if (pos + min_offset < 0 || pos + max_offset >= dim)
+    return 0;
+  if (delta > 0)
+    return u64((dim - 1 - (pos + max_offset)) / delta) + 1;
+  if (delta < 0)
+    return u64((pos + min_offset) / -delta) + 1;
+  return UINT64_MAX;
+}
+
+// Carries the ant along `pat` by up to `max_periods` whole periods, stopping
+// short of any cell ahead which doesn't read what the pattern expects. Only the
+// final shade of each cell is written, except for the last `max_revisit_periods`
+// periods where cells may still be revisited. Returns the number of periods.
+static
+u64 fast_forward(simulation::state &state, highway_pattern const &pat, u64 max_periods)
+{
+  i64 const stride = state.grid_stride();
+  i64 const start_col = state.ant_col;
+  i64 const start_row = state.ant_row;
+
+  auto const cell_idx = [&](u64 const period, pattern_step const &step) -> u64 {
+    i64 const col = start_col + (i64(period) * pat.col_delta) + step.col_offset;
+    i64 const row = start_row + (i64(period) * pat.row_delta) + step.row_offset;
+    return u64((row * stride) + col);
+  };
+
+  // the step out of each period has to land on the grid too
+  max_periods = std::min({
+    max_periods,
+    periods_within_bounds(
+      start_col, pat.col_delta,
+      std::min(pat.min_col_offset, pat.col_delta), std::max(pat.max_col_offset, pat.col_delta),
+      state.grid_width),
+    periods_within_bounds(
+      start_row, pat.row_delta,
+      std::min(pat.min_row_offset, pat.row_delta), std::max(pat.max_row_offset, pat.row_delta),
+      state.grid_height),
+  });
+
+  u64 num_periods = 0;
+  for (; num_periods < max_periods; ++num_periods) {
+    b8 const as_expected = std::all_of(pat.first_visits.begin(), pat.first_visits.end(), [&](u32 const i) {
+      return state.get_cell(cell_idx(num_periods, pat.steps[i])) == pat.steps[i].shade_read;
+    });
+    if (!as_expected)
+      break;
+  }
+
+  u64 const num_tail_periods = std::min(num_periods, u64(pat.max_revisit_periods));
+
+  for (u64 p = 0; p < num_periods - num_tail_periods; ++p)
+    for (u32 const i : pat.last_visits)
+      state.set_cell(cell_idx(p, pat.steps[i]), pat.steps[i].shade_written);
+
+  for (u64 p = num_periods - num_tail_periods; p < num_periods; ++p)
+    for (pattern_step const &step : pat.steps)
+      state.set_cell(cell_idx(p, step), step.shade_written);
+
+  state.ant_col = i32(start_col + (i64(num_periods) * pat.col_delta));
+  state.ant_row = i32(start_row + (i64(num_periods) * pat.row_delta));
+  state.generation += num_periods * pat.steps.size();
+  // orientation is the same at the start of every period
+
+  return num_periods;
+}
+
+u64 simulation::step_forward_fast_forwarding_highways(
+  state &state,
+  step_kernel const &kernel,
+  memo_table *const memo,
+  highway_tracker &tracker,
+  u64 const max_steps)
+{
+  u64 steps_taken = 0;
+
+  while (steps_taken < max_steps) {
+    u64 const budget = max_steps - steps_taken;
+
+    if (tracker.steps_until_check > 0) {
+      u64 const burst = std::min(tracker.steps_until_check, budget);
+      u64 const completed = memo != nullptr
+        ? step_forward_memoized(state, kernel, *memo, burst)
+        : step_forward(state, kernel, burst);
+
+      steps_taken += completed;
+      tracker.steps_until_check -= completed;
+
+      if (completed < burst)
+        break; // hit edge
+      continue;
+    }
+
+    tracker.history.clear();
+    u64 const burst = std::min(s_history_len, budget);
+    u64 const recorded = record_steps(state, kernel, tracker.history, burst);
+    steps_taken += recorded;
+
+    if (recorded < burst)
+      break; // hit edge
+
+    highway_pattern pat;
+    u64 num_periods = 0;
+
+    if (recorded == s_history_len && detect_highway(tracker.history, state.rules, pat)) {
+      u64 const period = pat.steps.size();
+      u64 const max_periods = (max_steps - steps_taken) / period;
+
+      if (max_periods * period >= s_min_fast_forward_gens)
+        num_periods = fast_forward(state, pat, max_periods);
+
+      if (num_periods > 0) {
+        tracker.period = u32(period);
+        tracker.col_delta = pat.col_delta;
+        tracker.row_delta = pat.row_delta;
+        ++tracker.num_fast_forwards;
+        tracker.gens_fast_forwarded += num_periods * period;
+        steps_taken += num_periods * period;
+        state.last_step_res = step_result::SUCCESS;
+      }
+    }
+
+    // a jump ends at the edge, `max_steps` or some obstacle ahead, which
+    // stepping is left to deal with, so back off unless that's paying off
+    if (num_periods == 0)
+      tracker.check_interval = std::min(tracker.check_interval * 2, s_max_check_interval);
+    tracker.steps_until_check = tracker.check_interval;
+  }
+
+  return steps_taken;
+}
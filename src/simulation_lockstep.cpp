@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cassert>
+
+#include "platform.hpp"
+#include "simulation.hpp"
+
+#if ON_WINDOWS
+#  include <xmmintrin.h>
+#endif
+
+// Rounds of lockstep between checks for lanes which are done.
+static u64 const s_max_rounds_per_check = 1 << 12;
+
+static
+void prefetch(void const *const addr)
+{
+#if ON_WINDOWS
+  _mm_prefetch(static_cast<char const *>(addr), _MM_HINT_T0);
+#else
+  __builtin_prefetch(addr);
+#endif
+}
+
+// Each lane is an independent chain of load -> table lookup -> store, so more
+// lanes overlap more cache misses, up to the point where lane state no longer
+// fits in registers.
+template <u32 NumLanes>
+void lockstep_impl(
+  std::vector<simulation::state *> const &states,
+  std::vector<u64> const &max_steps,
+  std::vector<simulation::transition_table_t> const &tables)
+{
+  using namespace simulation;
+
+  // structure of arrays, one entry per lane. An idle lane has a 0x0 grid, so
+  // none of its steps are ever on the grid and it never moves.
+  u8 *cell[NumLanes];
+  transition const *table[NumLanes];
+  u32 col[NumLanes], row[NumLanes];
+  u32 width[NumLanes], height[NumLanes];
+  u32 orient_idx[NumLanes];
+  u64 taken[NumLanes]; // since the last check
+  u64 total_taken[NumLanes];
+  u64 remaining[NumLanes];
+  state *lane_state[NumLanes];
+
+  u8 idle_cell = 0;
+  u64 next_state = 0;
+  u32 num_busy = 0;
+
+  auto const load_lane = [&](u32 const l) {
+    // lanes step whole bytes of row by row grids with edges, the others are
+    // left for the caller to step
+    while (next_state < states.size() && (max_steps[next_state] == 0 ||
+      (states[next_state]->layout != grid_layout::DENSE && states[next_state]->layout != grid_layout::BORDERED) ||
+      states[next_state]->boundary != grid_boundary::EDGE))
+      ++next_state;
+
+    if (next_state == states.size()) {
+      cell[l] = &idle_cell;
+      table[l] = tables[0].data();
+      col[l] = row[l] = width[l] = height[l] = 0;
+      orient_idx[l] = 0;
+      total_taken[l] = 0;
+      remaining[l] = UINT64_MAX;
+      lane_state[l] = nullptr;
+      return;
+    }
+
+    state &s = *states[next_state];
+    cell[l] = s.grid + (u64(s.ant_row) * u64(s.grid_stride())) + u64(s.ant_col);
+    table[l] = tables[next_state].data();
+    col[l] = u32(s.ant_col);
+    row[l] = u32(s.ant_row);
+    width[l] = u32(s.grid_width);
+    height[l] = u32(s.grid_height);
+    orient_idx[l] = u32(s.ant_orientation - orientation::NORTH);
+    total_taken[l] = 0;
+    remaining[l] = max_steps[next_state];
+    lane_state[l] = &s;
+    ++next_state;
+    ++num_busy;
+  };
+
+  auto const unload_lane = [&](u32 const l) {
+    state &s = *lane_state[l];
+    s.ant_col = i32(col[l]);
+    s.ant_row = i32(row[l]);
+    s.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx[l]));
+    s.generation += total_taken[l];
+    if (total_taken[l] > 0)
+      s.last_step_res = step_result::SUCCESS;
+    --num_busy;
+  };
+
+  for (u32 l = 0; l < NumLanes; ++l)
+    load_lane(l);
+
+  while (num_busy > 0) {
+    u64 rounds = s_max_rounds_per_check;
+    for (u32 l = 0; l < NumLanes; ++l) {
+      rounds = std::min(rounds, remaining[l]);
+      taken[l] = 0;
+    }
+
+    for (u64 r = 0; r < rounds; ++r) {
+      for (u32 l = 0; l < NumLanes; ++l) {
+        u8 *const p = cell[l];
+        u8 const shade = *p;
+        transition const t = table[l][(u32(shade) << 2) | orient_idx[l]];
+
+        // casting to unsigned makes -1 wrap around to a huge value,
+        // so each axis only needs a single comparison
+        u32 const next_col = col[l] + u32(i32(t.col_delta));
+        u32 const next_row = row[l] + u32(i32(t.row_delta));
+
+        // a step off the grid isn't taken at all, so a lane facing the edge
+        // stays put, reading the same cell and facing the edge every round
+        b8 const on_grid = (next_col < width[l]) & (next_row < height[l]);
+
+        *p = on_grid ? t.replacement_shade : shade;
+        orient_idx[l] = on_grid ? t.orientation_idx : orient_idx[l];
+        col[l] = on_grid ? next_col : col[l];
+        row[l] = on_grid ? next_row : row[l];
+        cell[l] = p + (on_grid ? t.idx_delta : 0);
+        taken[l] += on_grid;
+
+        // the other lanes step before this one reads its next cell,
+        // which is how long the prefetch has to arrive
+        prefetch(cell[l]);
+      }
+    }
+
+    for (u32 l = 0; l < NumLanes; ++l) {
+      if (lane_state[l] == nullptr)
+        continue;
+
+      total_taken[l] += taken[l];
+      remaining[l] -= taken[l];
+
+      b8 const facing_edge = taken[l] < rounds;
+      if (remaining[l] == 0 || facing_edge) {
+        unload_lane(l);
+        load_lane(l);
+      }
+    }
+  }
+}
+
+void simulation::step_forward_lockstep(
+  std::vector<state *> const &states,
+  std::vector<u64> const &max_steps,
+  u32 const num_lanes)
+{
+  assert(states.size() == max_steps.size());
+
+  if (states.empty())
+    return;
+
+  std::vector<transition_table_t> tables(states.size());
+  for (u64 i = 0; i < states.size(); ++i)
+    tables[i] = compile_rules(states[i]->rules, states[i]->grid_stride(), states[i]->shade_remap);
+
+  switch (num_lanes) {
+    case 1: lockstep_impl<1>(states, max_steps, tables); break;
+    case 2: lockstep_impl<2>(states, max_steps, tables); break;
+    case 3: lockstep_impl<3>(states, max_steps, tables); break;
+    case 4: lockstep_impl<4>(states, max_steps, tables); break;
+    case 5: lockstep_impl<5>(states, max_steps, tables); break;
+    case 6: lockstep_impl<6>(states, max_steps, tables); break;
+    case 7: lockstep_impl<7>(states, max_steps, tables); break;
+    default:
+    case 8: lockstep_impl<8>(states, max_steps, tables); break;
+  }
+}
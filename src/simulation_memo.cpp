@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "simulation.hpp"
+
+using simulation::memo_entry;
+
+// Excursions longer than this (an ant stuck going round in circles inside a
+// tile, for example) are cut short and never memoized.
+static u64 const s_max_excursion_moves = 1 << 16;
+
+// How many lookups make up a timed window of memoized stepping.
+static u64 const s_window_lookups = 1 << 14;
+
+// Bounds on the length of kernel bursts, in generations.
+static u64 const s_min_kernel_burst = 1 << 22;
+static u64 const s_max_kernel_burst = 1 << 30;
+
+// Kernel bursts shorter than this are too short to time reliably.
+static u64 const s_min_timed_kernel_burst = 1 << 16;
+
+simulation::memo_table::memo_table(u64 const max_bytes)
+  : entries(std::bit_floor(std::max(max_bytes / sizeof(memo_entry), u64(1)))),
+    stats{},
+    kernel_gens_per_ns{0},
+    kernel_burst{s_min_kernel_burst},
+    kernel_steps_remaining{0},
+    window_lookups{0},
+    window_steps{0},
+    window_start{util::current_time()}
+{}
+
+static
+u64 hash_tile(u8 const *const cells, u32 const pos, u32 const orient_idx)
+{
+  u64 hash = (u64(orient_idx) << 8) | pos;
+
+  for (u32 i = 0; i < memo_entry::TILE_CELLS; i += sizeof(u64)) {
+    u64 chunk;
+    std::memcpy(&chunk, cells + i, sizeof(chunk));
+    hash = (hash ^ chunk) * 0x9e3779b97f4a7c15;
+    hash ^= hash >> 32;
+  }
+
+  return hash;
+}
+
+struct excursion
+{
+  u32 num_moves;
+  u32 exit_pos;
+  u32 exit_orient_idx;
+  b8 exited;
+};
+
+// Steps the ant through `cells`, a tile_width x tile_height tile with rows
+// memo_entry::TILE_DIM apart, until a step points it out of the tile or
+// `max_moves` moves have been made.
+static
+excursion walk_tile(
+  u8 *const cells,
+  u32 const tile_width,
+  u32 const tile_height,
+  u32 const entry_pos,
+  u32 const entry_orient_idx,
+  simulation::transition const *const table,
+  u64 const max_moves)
+{
+  u32 const dim = memo_entry::TILE_DIM;
+
+  u32 col = entry_pos % dim;
+  u32 row = entry_pos / dim;
+  u32 orient_idx = entry_orient_idx;
+
+  for (u64 i = 0; i < max_moves; ++i) {
+    u32 const pos = (row * dim) + col;
+    simulation::transition const t = table[(u32(cells[pos]) << 2) | orient_idx];
+
+    cells[pos] = t.replacement_shade;
+    orient_idx = t.orientation_idx;
+
+    // casting to unsigned makes -1 wrap around to a huge value,
+    // so each axis only needs a single comparison
+    u32 const next_col = col + u32(i32(t.col_delta));
+    u32 const next_row = row + u32(i32(t.row_delta));
+
+    if (next_col >= tile_width || next_row >= tile_height)
+      return { u32(i), pos, orient_idx, true };
+
+    col = next_col;
+    row = next_row;
+  }
+
+  return { u32(max_moves), (row * dim) + col, orient_idx, false };
+}
+
+u64 simulation::step_forward_memoized(
+  simulation::state &state,
+  step_kernel const &kernel,
+  memo_table &memo,
+  u64 const max_steps)
+{
+  u32 const dim = memo_entry::TILE_DIM;
+  i8 const col_deltas[4] { 0, 1, 0, -1 };
+  i8 const row_deltas[4] { -1, 0, 1, 0 };
+
+  u8 *const grid = state.grid;
+  u64 const stride = u64(state.grid_stride());
+  u32 const width = u32(state.grid_width);
+  u32 const height = u32(state.grid_height);
+  b8 const packed = state.layout == grid_layout::PACKED;
+  b8 const sparse = state.layout == grid_layout::SPARSE;
+  b8 const tiled = state.layout == grid_layout::TILED || sparse;
+  // memo tiles always fit within a grid tile, whose rows are a grid tile apart
+  static_assert(GRID_TILE_DIM % memo_entry::TILE_DIM == 0);
+  u64 const mem_stride = tiled ? GRID_TILE_DIM : stride;
+  u64 const grid_tiles_per_row = (u64(width) + GRID_TILE_DIM - 1) / GRID_TILE_DIM;
+  u64 const slot_mask = memo.entries.size() - 1;
+
+  u32 col = u32(state.ant_col);
+  u32 row = u32(state.ant_row);
+  u32 orient_idx = u32(state.ant_orientation - orientation::NORTH);
+
+  u64 steps_taken = 0;
+  u64 kernel_steps_taken = 0; // already added to state.generation by the kernel
+  b8 hit_edge = false;
+
+  while (steps_taken < max_steps) {
+    u64 const budget = max_steps - steps_taken;
+
+    if (memo.kernel_steps_remaining > 0) {
+      u64 const burst = std::min(memo.kernel_steps_remaining, budget);
+
+      state.ant_col = i32(col);
+      state.ant_row = i32(row);
+      state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+
+      util::time_point_t const burst_start = util::current_time();
+      u64 const completed = kernel.function(state, kernel, burst);
+      u64 const burst_ns = util::nanos_between(burst_start, util::current_time());
+
+      col = u32(state.ant_col);
+      row = u32(state.ant_row);
+      orient_idx = u32(state.ant_orientation - orientation::NORTH);
+
+      steps_taken += completed;
+      kernel_steps_taken += completed;
+      memo.stats.kernel_steps += completed;
+      memo.kernel_steps_remaining -= completed;
+
+      if (completed >= s_min_timed_kernel_burst)
+        memo.kernel_gens_per_ns = f64(completed) / f64(std::max(burst_ns, u64(1)));
+
+      if (completed < burst) {
+        hit_edge = true;
+        break;
+      }
+
+      if (memo.kernel_steps_remaining == 0) {
+        memo.window_lookups = 0;
+        memo.window_steps = 0;
+        memo.window_start = util::current_time();
+      }
+
+      continue;
+    }
+
+    u32 const tile_col = col & ~(dim - 1);
+    u32 const tile_row = row & ~(dim - 1);
+    u32 const tile_width = std::min(dim, width - tile_col);
+    u32 const tile_height = std::min(dim, height - tile_row);
+    b8 const memoizable = tile_width == dim && tile_height == dim;
+    u64 const tile_origin_idx = (u64(tile_row) * stride) + tile_col;
+    u8 *tile_origin = grid; // packed tiles go through get_cell/set_cell instead
+    if (tiled) {
+      u64 const grid_tile = ((tile_row / GRID_TILE_DIM) * grid_tiles_per_row) + (tile_col / GRID_TILE_DIM);
+      tile_origin = sparse
+        ? commit_chunk(*state.sparse, grid_tile)
+        : grid + (grid_tile * GRID_TILE_DIM * GRID_TILE_DIM);
+      tile_origin += ((tile_row % GRID_TILE_DIM) * GRID_TILE_DIM) + (tile_col % GRID_TILE_DIM);
+    } else if (!packed) {
+      tile_origin += tile_origin_idx;
+    }
+
+    std::array<u8, memo_entry::TILE_CELLS> cells;
+    if (packed) {
+      // tiles always hold one shade per byte, as stored, packed cells are
+      // unpacked one by one
+      for (u32 r = 0; r < tile_height; ++r)
+        for (u32 c = 0; c < tile_width; ++c)
+          cells[(r * dim) + c] = u8(state.get_cell(tile_origin_idx + (r * stride) + c) ^ state.shade_remap);
+    } else if (memoizable) {
+      // a constant size lets these compile down to single loads and stores
+      for (u32 r = 0; r < dim; ++r)
+        std::memcpy(cells.data() + (r * dim), tile_origin + (r * mem_stride), dim);
+    } else {
+      for (u32 r = 0; r < tile_height; ++r)
+        std::memcpy(cells.data() + (r * dim), tile_origin + (r * mem_stride), tile_width);
+    }
+
+    u32 const entry_pos = ((row - tile_row) * dim) + (col - tile_col);
+    memo_entry *slot = nullptr;
+    excursion exc;
+    b8 recalled = false;
+
+    if (memoizable) {
+      ++memo.stats.lookups;
+      slot = &memo.entries[hash_tile(cells.data(), entry_pos, orient_idx) & slot_mask];
+
+      b8 const match =
+        slot->occupied &&
+        slot->entry_pos == entry_pos &&
+        slot->entry_orient_idx == orient_idx &&
+        slot->cells_before == cells;
+
+      // a remembered excursion is all or nothing, so it has to fit within budget,
+      // including the step out of the tile
+      if (match && slot->num_moves < budget) {
+        ++memo.stats.hits;
+        cells = slot->cells_after;
+        exc = { slot->num_moves, slot->exit_pos, slot->exit_orient_idx, true };
+        recalled = true;
+      }
+    }
+
+    if (!recalled) {
+      std::array<u8, memo_entry::TILE_CELLS> const cells_before = cells;
+
+      exc = walk_tile(
+        cells.data(), tile_width, tile_height, entry_pos, orient_idx,
+        kernel.transitions.data(), std::min(budget, s_max_excursion_moves));
+
+      if (memoizable && exc.exited) {
+        ++memo.stats.stores;
+        slot->cells_before = cells_before;
+        slot->cells_after = cells;
+        slot->num_moves = exc.num_moves;
+        slot->entry_pos = u8(entry_pos);
+        slot->entry_orient_idx = u8(orient_idx);
+        slot->exit_pos = u8(exc.exit_pos);
+        slot->exit_orient_idx = u8(exc.exit_orient_idx);
+        slot->occupied = true;
+      }
+    }
+
+    if (packed) {
+      for (u32 r = 0; r < tile_height; ++r)
+        for (u32 c = 0; c < tile_width; ++c)
+          state.set_cell(tile_origin_idx + (r * stride) + c, u8(cells[(r * dim) + c] ^ state.shade_remap));
+    } else if (memoizable) {
+      for (u32 r = 0; r < dim; ++r)
+        std::memcpy(tile_origin + (r * mem_stride), cells.data() + (r * dim), dim);
+    } else {
+      for (u32 r = 0; r < tile_height; ++r)
+        std::memcpy(tile_origin + (r * mem_stride), cells.data() + (r * dim), tile_width);
+    }
+
+    col = tile_col + (exc.exit_pos % dim);
+    row = tile_row + (exc.exit_pos / dim);
+    orient_idx = exc.exit_orient_idx;
+    steps_taken += exc.num_moves;
+    memo.window_steps += exc.num_moves + u64(exc.exited);
+
+    if (memoizable && ++memo.window_lookups == s_window_lookups) {
+      u64 const window_ns = util::nanos_between(memo.window_start, util::current_time());
+      f64 const memo_gens_per_ns = f64(memo.window_steps) / f64(std::max(window_ns, u64(1)));
+
+      if (memo.kernel_gens_per_ns <= 0) {
+        // nothing to compare against yet
+        memo.kernel_steps_remaining = memo.kernel_burst;
+      } else if (memo_gens_per_ns <= memo.kernel_gens_per_ns) {
+        memo.kernel_steps_remaining = memo.kernel_burst;
+        memo.kernel_burst = std::min(memo.kernel_burst * 2, s_max_kernel_burst);
+      } else {
+        memo.kernel_burst = s_min_kernel_burst;
+      }
+
+      memo.window_lookups = 0;
+      memo.window_steps = 0;
+      memo.window_start = util::current_time();
+    }
+
+    if (exc.exited) {
+      // the exit step already replaced its cell and turned the ant, all that's
+      // left is moving into the neighbouring tile, if there is one
+      u32 const next_col = col + u32(i32(col_deltas[orient_idx]));
+      u32 const next_row = row + u32(i32(row_deltas[orient_idx]));
+
+      if (next_col >= width || next_row >= height) {
+        hit_edge = true;
+        break;
+      }
+
+      col = next_col;
+      row = next_row;
+      ++steps_taken;
+    }
+  }
+
+  state.ant_col = i32(col);
+  state.ant_row = i32(row);
+  state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+  state.generation += steps_taken - kernel_steps_taken;
+
+  if (hit_edge)
+    state.last_step_res = step_result::HIT_EDGE;
+  else if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
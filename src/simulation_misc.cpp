@@ -1,5 +1,21 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "platform.hpp"
 #include "simulation.hpp"
 
+#if ON_WINDOWS
+# define NOMINMAX
+# include <Windows.h>
+#elif ON_LINUX
+# include <fcntl.h>
+# include <linux/fs.h>
+# include <sys/ioctl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
 u8 simulation::next_cluster(std::vector<std::filesystem::path> const &clusters)
 {
   // [0]   is the number of times "cluster1" occurred,
@@ -155,6 +171,677 @@ u64 simulation::state::num_pixels() const noexcept
   return u64(this->grid_width) * u64(this->grid_height);
 }
 
+i32 simulation::state::grid_stride() const noexcept
+{
+  return this->layout == grid_layout::BORDERED ? this->grid_width + 2 : this->grid_width;
+}
+
+// Where cell `idx` (row * grid_width + col) of a TILED grid lives,
+// for a SPARSE grid it's the chunk times the size of a chunk plus the offset within.
+static
+u64 tiled_offset(simulation::state const &state, u64 const idx) noexcept
+{
+  u64 const dim = simulation::GRID_TILE_DIM;
+  u64 const width = u64(state.grid_width);
+  u64 const col = idx % width;
+  u64 const row = idx / width;
+  u64 const tiles_per_row = (width + dim - 1) / dim;
+  u64 const tile = ((row / dim) * tiles_per_row) + (col / dim);
+  return (tile * dim * dim) + ((row % dim) * dim) + (col % dim);
+}
+
+// Bytes taken up by a TILED grid, including padding.
+static
+u64 tiled_size(simulation::state const &state) noexcept
+{
+  u64 const dim = simulation::GRID_TILE_DIM;
+  u64 const tiles_per_row = (u64(state.grid_width) + dim - 1) / dim;
+  u64 const tiles_per_col = (u64(state.grid_height) + dim - 1) / dim;
+  return tiles_per_row * tiles_per_col * dim * dim;
+}
+
+// tiles line up with pages
+static std::align_val_t const s_tiled_alignment{ 4096 };
+
+static u64 const s_chunk_cells = u64(simulation::GRID_TILE_DIM) * simulation::GRID_TILE_DIM;
+
+static u64 const s_huge_page_size = u64(2) * 1024 * 1024;
+
+// Anonymous memory straight from the OS, which reads as zero and only gets
+// backed by physical pages once written to, by huge pages if `pages` asks for
+// them and the OS obliges. What it got goes in `got`. Null if the mapping failed.
+static
+u8 *map_zeroed(u64 const num_bytes, simulation::huge_pages const pages, simulation::huge_pages &got)
+{
+  using simulation::huge_pages;
+
+  got = huge_pages::OFF;
+
+#if ON_WINDOWS
+  // large pages need the lock memory privilege and can't be committed lazily,
+  // not worth it
+  (void)pages;
+  return static_cast<u8 *>(VirtualAlloc(nullptr, num_bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+  if (pages == huge_pages::HUGETLB) {
+    u64 const rounded = ((num_bytes + s_huge_page_size - 1) / s_huge_page_size) * s_huge_page_size;
+    void *const addr = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+      got = huge_pages::HUGETLB;
+      return static_cast<u8 *>(addr);
+    }
+  }
+
+  void *const addr = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (addr == MAP_FAILED)
+    return nullptr;
+
+  if (pages != huge_pages::OFF && madvise(addr, num_bytes, MADV_HUGEPAGE) == 0)
+    got = huge_pages::THP;
+
+  return static_cast<u8 *>(addr);
+#endif
+}
+
+// How much `map_zeroed` actually mapped for a grid.
+static
+u64 mapped_size(simulation::state const &state) noexcept
+{
+  u64 const num_bytes = state.grid_bytes();
+  if (state.grid_pages == simulation::huge_pages::HUGETLB)
+    return ((num_bytes + s_huge_page_size - 1) / s_huge_page_size) * s_huge_page_size;
+  return num_bytes;
+}
+
+// Also takes grids which don't start on a page, like ones mapped straight from
+// a PGM file, see `parse_state`.
+static
+void unmap(u8 *const addr, u64 const num_bytes)
+{
+#if ON_WINDOWS
+  (void)num_bytes;
+  VirtualFree(addr, 0, MEM_RELEASE);
+#else
+  u64 const page_offset = reinterpret_cast<uintptr_t>(addr) % u64(sysconf(_SC_PAGESIZE));
+  munmap(addr - page_offset, num_bytes + page_offset);
+#endif
+}
+
+// Zeroes memory from `map_zeroed`, on Linux by handing its pages back.
+static
+void rezero(u8 *const addr, u64 const num_bytes)
+{
+#if ON_WINDOWS
+  std::memset(addr, 0, num_bytes);
+#else
+  if (madvise(addr, num_bytes, MADV_DONTNEED) != 0)
+    std::memset(addr, 0, num_bytes);
+#endif
+}
+
+static
+b8 is_mapped(simulation::grid_layout const layout) noexcept
+{
+  using simulation::grid_layout;
+  return layout == grid_layout::DENSE || layout == grid_layout::PACKED || layout == grid_layout::TILED;
+}
+
+u8 *simulation::commit_chunk(sparse_chunks &sparse, u64 const chunk)
+{
+  u8 *&cells = sparse.chunks[chunk];
+  if (cells == nullptr) {
+    cells = new (s_tiled_alignment) u8[s_chunk_cells];
+    std::fill_n(cells, s_chunk_cells, sparse.fill_shade);
+    sparse.committed.push_back(chunk);
+  }
+  return cells;
+}
+
+// Leaves `chunk` in `sparse.committed`, for the caller to take out.
+static
+void release_chunk(simulation::sparse_chunks &sparse, u64 const chunk)
+{
+  ::operator delete[](sparse.chunks[chunk], s_tiled_alignment);
+  sparse.chunks[chunk] = nullptr;
+}
+
+static
+void release_all_chunks(simulation::sparse_chunks &sparse)
+{
+  for (u64 const chunk : sparse.committed)
+    release_chunk(sparse, chunk);
+  sparse.committed.clear();
+}
+
+u64 simulation::release_uniform_chunks(simulation::state &state)
+{
+  if (state.layout != grid_layout::SPARSE)
+    return 0;
+
+  sparse_chunks &sparse = *state.sparse;
+  u64 const num_before = sparse.committed.size();
+
+  auto const released = std::remove_if(sparse.committed.begin(), sparse.committed.end(), [&](u64 const chunk) {
+    u8 const *const cells = sparse.chunks[chunk];
+    if (!std::all_of(cells, cells + s_chunk_cells, [&](u8 const c) { return c == sparse.fill_shade; }))
+      return false;
+    release_chunk(sparse, chunk);
+    return true;
+  });
+  sparse.committed.erase(released, sparse.committed.end());
+
+  return num_before - sparse.committed.size();
+}
+
+u64 simulation::state::grid_bytes() const noexcept
+{
+  switch (this->layout) {
+    case grid_layout::BORDERED:
+      return u64(this->grid_stride()) * u64(this->grid_height + 2);
+    case grid_layout::PACKED:
+      return ((this->num_pixels() * this->bits_per_cell) + 7) / 8;
+    case grid_layout::TILED:
+      return tiled_size(*this);
+    case grid_layout::SPARSE:
+      return this->sparse->committed.size() * (s_chunk_cells + sizeof(u8 *));
+    case grid_layout::DENSE:
+    default:
+      return this->num_pixels();
+  }
+}
+
+static
+u8 load_cell(simulation::state const &state, u64 const idx) noexcept
+{
+  using simulation::grid_layout;
+
+  if (state.layout == grid_layout::TILED)
+    return state.grid[tiled_offset(state, idx)];
+
+  if (state.layout == grid_layout::SPARSE) {
+    u64 const offset = tiled_offset(state, idx);
+    u8 const *const cells = state.sparse->chunks[offset / s_chunk_cells];
+    return cells == nullptr ? state.sparse->fill_shade : cells[offset % s_chunk_cells];
+  }
+
+  if (state.bits_per_cell == 8)
+    return state.grid[idx];
+
+  u64 const cells_per_byte = 8u / state.bits_per_cell;
+  u32 const shift = u32(idx % cells_per_byte) * state.bits_per_cell;
+  return u8((state.grid[idx / cells_per_byte] >> shift) & ((1u << state.bits_per_cell) - 1));
+}
+
+static
+void store_cell(simulation::state &state, u64 const idx, u8 const value)
+{
+  using simulation::grid_layout;
+
+  if (state.layout == grid_layout::TILED) {
+    state.grid[tiled_offset(state, idx)] = value;
+    return;
+  }
+
+  if (state.layout == grid_layout::SPARSE) {
+    u64 const offset = tiled_offset(state, idx);
+    simulation::commit_chunk(*state.sparse, offset / s_chunk_cells)[offset % s_chunk_cells] = value;
+    return;
+  }
+
+  if (state.bits_per_cell == 8) {
+    state.grid[idx] = value;
+    return;
+  }
+
+  u64 const cells_per_byte = 8u / state.bits_per_cell;
+  u32 const shift = u32(idx % cells_per_byte) * state.bits_per_cell;
+  u32 const mask = ((1u << state.bits_per_cell) - 1) << shift;
+  u8 &byte = state.grid[idx / cells_per_byte];
+  byte = u8((byte & ~mask) | ((u32(value) << shift) & mask));
+}
+
+u8 simulation::state::get_cell(u64 const idx) const noexcept
+{
+  return u8(load_cell(*this, idx) ^ this->shade_remap);
+}
+
+void simulation::state::set_cell(u64 const idx, u8 const shade)
+{
+  store_cell(*this, idx, u8(shade ^ this->shade_remap));
+}
+
+// Calls `fn(segment, len)` for each run of cells of row `row` from `col` to
+// `col + width` which is contiguous in memory, where `segment` is null for
+// cells of a SPARSE chunk which hasn't been committed. PACKED grids have no
+// such runs and aren't handled.
+template <typename Fn>
+static
+void for_each_segment(simulation::state const &state, u32 const col, u32 const row, u32 const width, Fn &&fn)
+{
+  using simulation::grid_layout;
+
+  u64 const first_idx = (u64(row) * u64(state.grid_stride())) + col;
+
+  if (state.layout != grid_layout::TILED && state.layout != grid_layout::SPARSE) {
+    fn(state.grid + first_idx, u64(width));
+    return;
+  }
+
+  u64 const dim = simulation::GRID_TILE_DIM;
+  for (u64 c = 0; c < width;) {
+    u64 const offset = tiled_offset(state, first_idx + c);
+    u64 const len = std::min(u64(width) - c, dim - ((col + c) % dim));
+    u8 *segment;
+    if (state.layout == grid_layout::TILED) {
+      segment = state.grid + offset;
+    } else {
+      u8 *const chunk = state.sparse->chunks[offset / s_chunk_cells];
+      segment = chunk == nullptr ? nullptr : chunk + (offset % s_chunk_cells);
+    }
+    fn(segment, len);
+    c += len;
+  }
+}
+
+void simulation::load_cells(
+  state const &state,
+  u32 const col,
+  u32 const row,
+  u32 const width,
+  u32 const height,
+  u8 *const cells,
+  u64 const cells_stride)
+{
+  for (u32 r = 0; r < height; ++r) {
+    u8 *out = cells + (r * cells_stride);
+
+    if (state.layout == grid_layout::PACKED) {
+      u64 const first_idx = (u64(row + r) * u64(state.grid_stride())) + col;
+      for (u32 c = 0; c < width; ++c)
+        out[c] = load_cell(state, first_idx + c);
+      continue;
+    }
+
+    for_each_segment(state, col, row + r, width, [&](u8 const *const segment, u64 const len) {
+      if (segment == nullptr)
+        std::fill_n(out, len, state.sparse->fill_shade);
+      else
+        std::memcpy(out, segment, len);
+      out += len;
+    });
+  }
+}
+
+void simulation::store_cells(
+  state &state,
+  u32 const col,
+  u32 const row,
+  u32 const width,
+  u32 const height,
+  u8 const *const cells,
+  u64 const cells_stride)
+{
+  for (u32 r = 0; r < height; ++r) {
+    u8 const *in = cells + (r * cells_stride);
+    u64 const first_idx = (u64(row + r) * u64(state.grid_stride())) + col;
+
+    if (state.layout == grid_layout::PACKED) {
+      for (u32 c = 0; c < width; ++c)
+        if (load_cell(state, first_idx + c) != in[c])
+          store_cell(state, first_idx + c, in[c]);
+      continue;
+    }
+
+    u32 c = 0;
+    for_each_segment(state, col, row + r, width, [&](u8 *segment, u64 const len) {
+      if (segment == nullptr) {
+        if (std::all_of(in, in + len, [&](u8 const v) { return v == state.sparse->fill_shade; })) {
+          in += len;
+          c += u32(len);
+          return;
+        }
+        u64 const offset = tiled_offset(state, first_idx + c);
+        segment = commit_chunk(*state.sparse, offset / s_chunk_cells) + (offset % s_chunk_cells);
+      }
+      if (std::memcmp(segment, in, len) != 0)
+        std::memcpy(segment, in, len);
+      in += len;
+      c += u32(len);
+    });
+  }
+}
+
+u64 simulation::state::grid_resident_bytes() const
+{
+#if ON_LINUX
+  if (this->layout != grid_layout::SPARSE && this->grid != nullptr) {
+    u64 const page_size = u64(sysconf(_SC_PAGESIZE));
+    // BORDERED grids start a row and a cell into their allocation
+    u8 const *const first = this->layout == grid_layout::BORDERED
+      ? this->grid - this->grid_stride() - 1 : this->grid;
+    uintptr_t const begin = reinterpret_cast<uintptr_t>(first) & ~uintptr_t(page_size - 1);
+    uintptr_t const end = reinterpret_cast<uintptr_t>(first) + this->grid_bytes();
+    u64 const num_pages = (end - begin + page_size - 1) / page_size;
+
+    std::vector<unsigned char> resident(num_pages);
+    if (mincore(reinterpret_cast<void *>(begin), end - begin, resident.data()) == 0) {
+      u64 const num_resident = u64(std::count_if(resident.begin(), resident.end(),
+        [](unsigned char const page) { return (page & 1) != 0; }));
+      return num_resident * page_size;
+    }
+  }
+#endif
+
+  return this->grid_bytes();
+}
+
+b8 simulation::allocate_grid(simulation::state &state, grid_layout const layout, huge_pages const pages)
+{
+  state.layout = layout;
+  state.bits_per_cell = 8;
+  state.shade_remap = 0;
+  state.grid_pages = huge_pages::OFF;
+  state.file = nullptr;
+
+  if (layout == grid_layout::PACKED) {
+    u8 const maxval = deduce_maxval_from_rules(state.rules);
+    if (maxval < 2)
+      state.bits_per_cell = 1;
+    else if (maxval < 4)
+      state.bits_per_cell = 2;
+    else if (maxval < 16)
+      state.bits_per_cell = 4;
+    else
+      state.layout = grid_layout::DENSE;
+  }
+
+  if (state.layout == grid_layout::SPARSE) {
+    state.grid = nullptr;
+    try {
+      state.sparse = new sparse_chunks{ nullptr, tiled_size(state) / s_chunk_cells, {}, 0 };
+    } catch (std::bad_alloc const &) {
+      state.sparse = nullptr;
+      return false;
+    }
+    huge_pages table_pages;
+    state.sparse->chunks = reinterpret_cast<u8 **>(
+      map_zeroed(state.sparse->num_chunks * sizeof(u8 *), huge_pages::OFF, table_pages));
+    if (state.sparse->chunks == nullptr) {
+      delete state.sparse;
+      state.sparse = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  if (layout == grid_layout::BORDERED) {
+    // the lowest free shade keeps sentinel kernels' tables as small as possible
+    u32 shade = 0;
+    while (shade < 256 && state.rules[shade].turn_dir != turn_direction::NIL)
+      ++shade;
+
+    if (shade == 256)
+      state.layout = grid_layout::DENSE;
+    else
+      state.sentinel_shade = u8(shade);
+  }
+
+  if (is_mapped(state.layout)) {
+    state.grid = map_zeroed(state.grid_bytes(), pages, state.grid_pages);
+    return state.grid != nullptr;
+  }
+
+  // BORDERED
+  u64 const stride = u64(state.grid_stride());
+  u64 const num_cells = stride * u64(state.grid_height + 2);
+
+  u8 *cells;
+  try {
+    cells = new u8[num_cells];
+  } catch (std::bad_alloc const &) {
+    state.grid = nullptr;
+    return false;
+  }
+
+  // fill everything, the interior gets overwritten by whoever set up the grid
+  std::fill_n(cells, num_cells, state.sentinel_shade);
+
+  // grid points to the first interior cell, so (col, row) is still at row * stride + col
+  state.grid = cells + stride + 1;
+  return true;
+}
+
+void simulation::fill_grid(simulation::state &state, u8 const shade)
+{
+  if (state.layout == grid_layout::SPARSE) {
+    release_all_chunks(*state.sparse);
+    state.sparse->fill_shade = shade;
+    return;
+  }
+
+  if (is_mapped(state.layout) && state.file == nullptr) {
+    // all zero once the pages are handed back, padding included, so `shade`
+    // has to be what 0 stands for
+    rezero(state.grid, mapped_size(state));
+    state.shade_remap = shade;
+    return;
+  }
+
+  u64 const stride = u64(state.grid_stride());
+  for (u64 row = 0; row < u64(state.grid_height); ++row)
+    std::fill_n(state.grid + (row * stride), state.grid_width, shade);
+}
+
+// Unmaps and closes the file of a grid mapped by `map_grid_to_file`, deleting
+// it unless it was handed over.
+static
+void release_grid_file(simulation::state &state)
+{
+#if ON_LINUX
+  simulation::grid_file *const file = state.file;
+  munmap(file->mapping, file->num_bytes);
+  close(file->fd);
+  if (!file->handed_over) {
+    std::error_code ec;
+    std::filesystem::remove(file->path, ec);
+  }
+  delete file;
+#endif
+  state.file = nullptr;
+  state.grid = nullptr;
+}
+
+void simulation::free_grid(simulation::state &state)
+{
+  if (state.file != nullptr) {
+    release_grid_file(state);
+    return;
+  }
+
+  if (state.layout == grid_layout::SPARSE && state.sparse != nullptr) {
+    release_all_chunks(*state.sparse);
+    unmap(reinterpret_cast<u8 *>(state.sparse->chunks), state.sparse->num_chunks * sizeof(u8 *));
+    delete state.sparse;
+    state.sparse = nullptr;
+    return;
+  }
+
+  if (state.grid == nullptr)
+    return;
+
+  if (state.layout == grid_layout::BORDERED)
+    delete[] (state.grid - state.grid_stride() - 1);
+  else
+    unmap(state.grid, mapped_size(state));
+
+  state.grid = nullptr;
+}
+
+b8 simulation::map_grid_to_file(simulation::state &state, std::filesystem::path const &path)
+{
+  if (state.file != nullptr && !state.file->handed_over)
+    return true;
+
+#if ON_LINUX
+  if (state.layout != grid_layout::DENSE)
+    return false;
+
+  std::string header;
+  try {
+    pgm8::image_properties props;
+    props.set_format(pgm8::format::RAW);
+    props.set_width(u32(state.grid_width));
+    props.set_height(u32(state.grid_height));
+    props.set_maxval(state.maxval);
+    header = pgm8::header(props);
+  } catch (std::runtime_error const &) {
+    return false;
+  }
+
+  u64 const num_bytes = header.size() + state.num_pixels();
+  i32 const fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return false;
+
+  void *const addr = ftruncate(fd, off_t(num_bytes)) == 0
+    ? mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+    : MAP_FAILED;
+  if (addr == MAP_FAILED) {
+    close(fd);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    return false;
+  }
+
+  u8 *const mapping = static_cast<u8 *>(addr);
+  std::memcpy(mapping, header.data(), header.size());
+  u8 *const cells = mapping + header.size();
+
+  // the file holds real shades, so shade_remap has to go
+  u32 const width = u32(state.grid_width);
+  load_cells(state, 0, 0, width, u32(state.grid_height), cells, width);
+  if (state.shade_remap != 0) {
+    for (u64 i = 0; i < state.num_pixels(); ++i)
+      cells[i] ^= state.shade_remap;
+  }
+
+  free_grid(state);
+  state.grid = cells;
+  state.file = new grid_file{ path, mapping, num_bytes, fd, false };
+  state.shade_remap = 0;
+  state.grid_pages = huge_pages::OFF;
+  return true;
+#else
+  (void)state;
+  (void)path;
+  return false;
+#endif
+}
+
+b8 simulation::save_grid_file(simulation::state const &state, std::filesystem::path const &path, b8 const hand_over)
+{
+#if ON_LINUX
+  grid_file &file = *state.file;
+
+  // writeback is up to the kernel, same as for a save written through a stream
+  msync(file.mapping, file.num_bytes, MS_ASYNC);
+
+  if (hand_over) {
+    std::error_code ec;
+    std::filesystem::rename(file.path, path, ec);
+    if (!ec) {
+      file.path = path;
+      file.handed_over = true;
+      return true;
+    }
+  }
+
+  i32 const fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return false;
+
+  // copy-on-write file systems share the file's blocks instead of copying them
+  b8 success = ioctl(fd, FICLONE, file.fd) == 0;
+  for (off_t offset = 0; !success && offset < off_t(file.num_bytes);) {
+    ssize_t const copied = copy_file_range(file.fd, &offset, fd, nullptr, file.num_bytes - u64(offset), 0);
+    if (copied <= 0)
+      break;
+    success = offset == off_t(file.num_bytes);
+  }
+
+  success &= close(fd) == 0;
+  return success;
+#else
+  (void)state;
+  (void)path;
+  (void)hand_over;
+  return false;
+#endif
+}
+
+b8 simulation::grow_grid(simulation::state &state, i32 const max_dim)
+{
+  i8 const col_deltas[4] { 0, 1, 0, -1 };
+  i8 const row_deltas[4] { -1, 0, 1, 0 };
+
+  u32 const orient_idx = u32(state.ant_orientation - orientation::NORTH);
+  i64 const next_col = i64(state.ant_col) + col_deltas[orient_idx];
+  i64 const next_row = i64(state.ant_row) + row_deltas[orient_idx];
+  b8 const off_cols = next_col < 0 || next_col >= state.grid_width;
+  b8 const off_rows = next_row < 0 || next_row >= state.grid_height;
+
+  i32 const width = state.grid_width;
+  i32 const height = state.grid_height;
+  i32 const new_width = std::max(width, i32(std::min(i64(width) * 2, i64(max_dim))));
+  i32 const new_height = std::max(height, i32(std::min(i64(height) * 2, i64(max_dim))));
+
+  if ((off_cols && new_width == width) || (off_rows && new_height == height))
+    return false;
+
+  simulation::state grown = state;
+  grown.grid = nullptr;
+  grown.sparse = nullptr;
+  grown.grid_width = new_width;
+  grown.grid_height = new_height;
+
+  if (!allocate_grid(grown, state.layout, state.grid_pages))
+    return false;
+  fill_grid(grown, state.background_shade);
+
+  // the old grid goes in the middle, a row at a time so that both grids never
+  // need a full copy on the side. Capped growth can add a single column or
+  // row, which has to go on the side being stepped off
+  u32 const col_offset = next_col < 0 ? std::max(1u, u32(new_width - width) / 2) : u32(new_width - width) / 2;
+  u32 const row_offset = next_row < 0 ? std::max(1u, u32(new_height - height) / 2) : u32(new_height - height) / 2;
+  u8 const remap = u8(state.shade_remap ^ grown.shade_remap);
+  std::vector<u8> row_cells(static_cast<u64>(width));
+
+  try {
+    for (u32 row = 0; row < u32(height); ++row) {
+      load_cells(state, 0, row, u32(width), 1, row_cells.data(), 0);
+      if (remap != 0)
+        for (u8 &cell : row_cells)
+          cell ^= remap;
+      store_cells(grown, col_offset, row_offset + row, u32(width), 1, row_cells.data(), 0);
+    }
+  } catch (std::bad_alloc const &) {
+    free_grid(grown);
+    return false;
+  }
+
+  free_grid(state);
+  state = grown;
+
+  state.ant_col += i32(col_offset) + col_deltas[orient_idx];
+  state.ant_row += i32(row_offset) + row_deltas[orient_idx];
+  state.origin_col += i32(col_offset);
+  state.origin_row += i32(row_offset);
+  ++state.generation;
+  state.last_step_res = step_result::SUCCESS;
+
+  return true;
+}
+
 u64 simulation::state::generations_completed() const noexcept
 {
   assert(generation >= start_generation);
@@ -1,13 +1,20 @@
+#include <bit>
 #include <functional>
 #include <regex>
 #include <sstream>
 #include <string>
 
 #include "json.hpp"
+#include "platform.hpp"
 #include "primitives.hpp"
 #include "util.hpp"
 #include "simulation.hpp"
 
+#if ON_LINUX
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
 namespace fs = std::filesystem;
 using json_t = nlohmann::json;
 using util::errors_t;
@@ -189,6 +196,51 @@ b8 try_to_parse_and_set_rule(
   return true;
 }
 
+b8 simulation::validate_rules(rules_t const &rules, std::function<void(std::string &&)> const &add_err)
+{
+  std::array<u16, 256> shade_occurences{};
+  u64 num_defined_rules = 0;
+
+  for (u64 i = 0; i < rules.size(); ++i) {
+    auto const &r = rules[i];
+    b8 const is_rule_used = r.turn_dir != simulation::turn_direction::NIL;
+    if (is_rule_used) {
+      ++num_defined_rules;
+      ++shade_occurences[i];
+      ++shade_occurences[r.replacement_shade];
+    }
+  }
+
+  if (num_defined_rules < 2) {
+    add_err("bad rules, fewer than 2 defined");
+    return false;
+  }
+
+  u64 num_non_zero_occurences = 0, num_non_two_occurences = 0;
+  for (auto const occurencesOfShade : shade_occurences) {
+    if (occurencesOfShade != 0) {
+      ++num_non_zero_occurences;
+      if (occurencesOfShade != 2)
+        ++num_non_two_occurences;
+    }
+  }
+
+  if (num_non_zero_occurences < 2 || num_non_two_occurences > 0) {
+    add_err("bad rules, don't form a closed chain");
+    return false;
+  }
+
+  return true;
+}
+
+u64 simulation::first_unruled_shade(rules_t const &rules, std::array<b8, 256> const &shade_present)
+{
+  for (u64 shade = 0; shade < shade_present.size(); ++shade)
+    if (shade_present[shade] && rules[shade].turn_dir == turn_direction::NIL)
+      return shade;
+  return shade_present.size();
+}
+
 static
 b8 try_to_parse_and_set_rules(
   json_t const &json,
@@ -216,43 +268,332 @@ b8 try_to_parse_and_set_rules(
     }
   }
 
-  // validation
-  {
-    std::array<u16, 256> shade_occurences{};
-    u64 num_defined_rules = 0;
-
-    for (u64 i = 0; i < parsed_rules.size(); ++i) {
-      auto const &r = parsed_rules[i];
-      b8 const is_rule_used = r.turn_dir != simulation::turn_direction::NIL;
-      if (is_rule_used) {
-        ++num_defined_rules;
-        ++shade_occurences[i];
-        ++shade_occurences[r.replacement_shade];
+  if (!simulation::validate_rules(parsed_rules, add_err))
+    return false;
+
+  state.rules = parsed_rules;
+  return true;
+}
+
+static
+b8 image_fits_grid(
+  simulation::state const &state,
+  pgm8::image_properties const &img_props,
+  std::function<void(std::string &&)> const &add_err)
+{
+  if (img_props.num_pixels() == state.num_pixels())
+    return true;
+
+  if (u32(state.grid_width) != img_props.get_width()) {
+    add_err(make_str("dimension mismatch, image width (%" PRIu32 ") does not correspond to grid width (%d)",
+      img_props.get_width(), state.grid_width));
+  }
+  if (u32(state.grid_height) != img_props.get_height()){
+    add_err(make_str("dimension mismatch, image height (%" PRIu32 ") does not correspond to grid height (%d)",
+      img_props.get_height(), state.grid_height));
+  }
+  return false;
+}
+
+// Step kernels rely on every shade they encounter having a governing rule,
+// which can only be checked if the rules themselves parsed successfully.
+static
+b8 image_shades_ruled(
+  simulation::state const &state,
+  std::array<b8, 256> const &shade_present,
+  std::string const &grid_state,
+  std::function<void(std::string &&)> const &add_err,
+  errors_t const &errors)
+{
+  if (!errors.empty())
+    return true;
+
+  u64 const shade = simulation::first_unruled_shade(state.rules, shade_present);
+  if (shade < shade_present.size()) {
+    add_err(make_str("bad grid_state, shade %zu in file \"%s\" has no governing rule", shade, grid_state.c_str()));
+    return false;
+  }
+  return true;
+}
+
+// Allocates a grid laid out per `layout` and copies the pixels of an image
+// already in memory into it.
+static
+b8 try_to_copy_image_into_grid(
+  simulation::state &state,
+  u8 const *const pixels,
+  pgm8::image_properties const &img_props,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  std::function<void(std::string &&)> const &add_err)
+{
+  if (!simulation::allocate_grid(state, layout, pages)) {
+    add_err(make_str("unable to allocate %zu bytes for grid", img_props.num_pixels() * sizeof(u8)));
+    return false;
+  }
+
+  if (state.layout == simulation::grid_layout::SPARSE) {
+    // chunks of nothing but the lowest ruled shade are never committed
+    simulation::fill_grid(state, state.background_shade);
+    simulation::store_cells(state, 0, 0, u32(state.grid_width), u32(state.grid_height), pixels, u64(state.grid_width));
+  } else {
+    pgm8::read_pixels(pixels, img_props, state.grid, u64(state.grid_stride()), state.bits_per_cell,
+      state.layout == simulation::grid_layout::TILED ? simulation::GRID_TILE_DIM : 0);
+  }
+  return true;
+}
+
+// For grids which are a mapping of an image as they are.
+static
+void set_grid_to_mapping(simulation::state &state, u8 *const cells)
+{
+  // `free_grid` unmaps it like any other DENSE grid
+  state.layout = simulation::grid_layout::DENSE;
+  state.bits_per_cell = 8;
+  state.shade_remap = 0;
+  state.grid_pages = simulation::huge_pages::OFF;
+  state.file = nullptr;
+  state.grid = cells;
+}
+
+// The rest of `try_to_parse_and_set_grid_state` for a RAW image mapped by
+// `pgm8::map_raw`, which either becomes the grid (`view_as_grid`) or is copied
+// into one and unmapped.
+static
+b8 try_to_set_grid_from_mapped_image(
+  simulation::state &state,
+  pgm8::mapped_image &image,
+  b8 const view_as_grid,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  std::string const &grid_state,
+  std::function<void(std::string &&)> const &add_err,
+  errors_t const &errors)
+{
+  u8 *const raster = image.mapping + image.pixel_offset;
+  std::array<b8, 256> shade_present{};
+
+  b8 const fits = image_fits_grid(state, image.props, add_err);
+  if (fits) {
+    for (u64 i = 0; i < image.props.num_pixels(); ++i)
+      shade_present[raster[i]] = true;
+  }
+
+  if (!fits || !image_shades_ruled(state, shade_present, grid_state, add_err, errors)) {
+    pgm8::unmap(image);
+    return false;
+  }
+
+  if (view_as_grid) {
+    set_grid_to_mapping(state, raster);
+    return true;
+  }
+
+  b8 const success = try_to_copy_image_into_grid(state, raster, image.props, layout, pages, add_err);
+  pgm8::unmap(image);
+  return success;
+}
+
+// A grid of its own for `state` from a cached image. DENSE grids without huge
+// pages are private mappings, of the image's file for RAW images (as for
+// `map_raw` without a cache, the pages shared with the cached mapping through
+// the page cache) or of the memfd it was decoded into otherwise.
+static
+b8 try_to_clone_seed_image(
+  simulation::state &state,
+  fs::path const &img_path,
+  simulation::seed_image const &image,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  std::function<void(std::string &&)> const &add_err)
+{
+  if (layout == simulation::grid_layout::DENSE && pages == simulation::huge_pages::OFF) {
+    if (image.raw.mapping != nullptr) {
+      pgm8::mapped_image clone{};
+      try {
+        if (pgm8::map_raw(img_path.string().c_str(), clone, false)) {
+          set_grid_to_mapping(state, clone.mapping + clone.pixel_offset);
+          return true;
+        }
+      } catch (std::runtime_error const &) {
+        // changed since it was cached, the cached mapping is still good to copy
       }
     }
-
-    if (num_defined_rules < 2) {
-      add_err("bad rules, fewer than 2 defined");
-      return false;
+#if ON_LINUX
+    else if (image.fd >= 0) {
+      void *const addr = mmap(nullptr, image.num_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, image.fd, 0);
+      if (addr != MAP_FAILED) {
+        set_grid_to_mapping(state, static_cast<u8 *>(addr));
+        return true;
+      }
     }
+#endif
+  }
+
+  return try_to_copy_image_into_grid(state, image.pixels, image.props, layout, pages, add_err);
+}
+
+static
+void release_seed_image(simulation::seed_image &image)
+{
+  if (image.raw.mapping != nullptr) {
+    pgm8::unmap(image.raw);
+    return;
+  }
+#if ON_LINUX
+  if (image.fd >= 0) {
+    munmap(image.pixels, image.num_bytes);
+    close(image.fd);
+    return;
+  }
+#endif
+  delete[] image.pixels;
+}
+
+// Decodes the image at `img_path` for a `seed_image_cache`. RAW images are
+// just mapped, others are decoded, on Linux into a memfd so grids can be
+// private mappings of it. Throws if it can't be read.
+static
+simulation::seed_image load_seed_image(fs::path const &img_path)
+{
+  simulation::seed_image image{};
+  image.fd = -1;
 
-    u64 num_non_zero_occurences = 0, num_non_two_occurences = 0;
-    for (auto const occurencesOfShade : shade_occurences) {
-      if (occurencesOfShade != 0) {
-        ++num_non_zero_occurences;
-        if (occurencesOfShade != 2)
-          ++num_non_two_occurences;
+  if (pgm8::map_raw(img_path.string().c_str(), image.raw, true)) {
+    image.props = image.raw.props;
+    image.pixels = image.raw.mapping + image.raw.pixel_offset;
+    image.num_bytes = image.props.num_pixels();
+  } else {
+    std::ifstream file(img_path, std::ios::binary);
+    image.props = pgm8::read_properties(file);
+    image.num_bytes = image.props.num_pixels();
+
+#if ON_LINUX
+    image.fd = memfd_create("seed_image", MFD_CLOEXEC);
+    if (image.fd >= 0) {
+      void *const addr = ftruncate(image.fd, off_t(image.num_bytes)) == 0
+        ? mmap(nullptr, image.num_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, image.fd, 0)
+        : MAP_FAILED;
+      if (addr == MAP_FAILED) {
+        close(image.fd);
+        image.fd = -1;
+      } else {
+        image.pixels = static_cast<u8 *>(addr);
       }
     }
+#endif
+    if (image.fd < 0)
+      image.pixels = new u8[image.num_bytes];
 
-    if (num_non_zero_occurences < 2 || num_non_two_occurences > 0) {
-      add_err("bad rules, don't form a closed chain");
-      return false;
+    try {
+      pgm8::read_pixels(file, image.props, image.pixels);
+    } catch (...) {
+      release_seed_image(image);
+      throw;
     }
+
+#if ON_LINUX
+    // nothing writes to it from here on, which the clones rely on
+    if (image.fd >= 0)
+      mprotect(image.pixels, image.num_bytes, PROT_READ);
+#endif
   }
 
-  state.rules = parsed_rules;
-  return true;
+  for (u64 i = 0; i < image.num_bytes; ++i)
+    image.shade_present[image.pixels[i]] = true;
+
+  return image;
+}
+
+void simulation::release_seed_images(seed_image_cache &cache)
+{
+  std::scoped_lock lock(cache.mutex);
+  for (auto &[key, image] : cache.images)
+    release_seed_image(image);
+  cache.images.clear();
+  cache.pending_references.clear();
+}
+
+// What a `seed_image_cache` knows an image by, regardless of how states name it.
+static
+std::string seed_image_path(fs::path const &img_path)
+{
+  std::error_code ec;
+  fs::path const canonical_path = fs::weakly_canonical(img_path, ec);
+  return ec ? img_path.string() : canonical_path.string();
+}
+
+void simulation::count_seed_image_references(
+  seed_image_cache &cache,
+  std::vector<fs::path> const &state_files,
+  fs::path const &dir)
+{
+  std::scoped_lock lock(cache.mutex);
+  for (auto const &state_file : state_files) {
+    if (is_checkpoint(state_file))
+      continue;
+    try {
+      json_t const json = json_t::parse(util::extract_txt_file_contents(state_file.string(), false));
+      std::string const grid_state = json["grid_state"].get<std::string>();
+      if (!grid_state.empty() && !std::regex_match(grid_state, std::regex("^fill=.*$", std::regex_constants::icase)))
+        ++cache.pending_references[seed_image_path(dir / grid_state)];
+    } catch (std::exception const &) {
+      // parse_state will have something to say about it
+    }
+  }
+}
+
+// The rest of `try_to_parse_and_set_grid_state` for an image to come from a
+// `seed_image_cache`, loading it if it isn't there yet.
+static
+b8 try_to_set_grid_from_seed_image(
+  simulation::state &state,
+  fs::path const &img_path,
+  simulation::seed_image_cache &cache,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  std::string const &grid_state,
+  std::function<void(std::string &&)> const &add_err,
+  errors_t const &errors)
+{
+  std::error_code ec;
+  auto const key = std::make_pair(seed_image_path(img_path), fs::last_write_time(img_path, ec));
+
+  // once the last state counted as naming the image has had it, it goes
+  auto const drop_reference = [&] {
+    std::scoped_lock lock(cache.mutex);
+    auto const references = cache.pending_references.find(key.first);
+    if (references == cache.pending_references.end() || --references->second > 0)
+      return;
+    cache.pending_references.erase(references);
+    auto const cached = cache.images.find(key);
+    if (cached != cache.images.end()) {
+      release_seed_image(cached->second);
+      cache.images.erase(cached);
+    }
+  };
+
+  simulation::seed_image const *image;
+  {
+    std::scoped_lock lock(cache.mutex);
+    auto cached = cache.images.find(key);
+    if (cached == cache.images.end()) {
+      try {
+        cached = cache.images.emplace(key, load_seed_image(img_path)).first;
+      } catch (std::runtime_error const &except) {
+        add_err(make_str("failed to read file \"%s\" - %s", grid_state.c_str(), except.what()));
+      }
+    }
+    image = cached == cache.images.end() ? nullptr : &cached->second;
+  }
+
+  b8 const success = image != nullptr
+    && image_fits_grid(state, image->props, add_err)
+    && image_shades_ruled(state, image->shade_present, grid_state, add_err, errors)
+    && try_to_clone_seed_image(state, img_path, *image, layout, pages, add_err);
+
+  drop_reference();
+  return success;
 }
 
 static
@@ -261,7 +602,10 @@ b8 try_to_parse_and_set_grid_state(
   fs::path const &dir,
   simulation::state &state,
   std::function<void(std::string &&)> const &add_err,
-  errors_t const &errors)
+  errors_t const &errors,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  simulation::seed_image_cache *const seed_images)
 {
   std::string grid_state;
 
@@ -306,14 +650,13 @@ b8 try_to_parse_and_set_grid_state(
 
     // only try to allocate and setup grid if there are no errors
     u64 const num_pixels = state.num_pixels();
-    try {
-      state.grid = new u8[num_pixels];
-    } catch (std::bad_alloc const &) {
+    if (!simulation::allocate_grid(state, layout, pages)) {
       add_err(make_str("unable to allocate %zu bytes for grid", num_pixels * sizeof(u8)));
       return false;
     }
 
-    std::fill_n(state.grid, num_pixels, static_cast<u8>(fill_val));
+    simulation::fill_grid(state, static_cast<u8>(fill_val));
+    state.background_shade = static_cast<u8>(fill_val);
     return true;
 
   } else {
@@ -324,6 +667,33 @@ b8 try_to_parse_and_set_grid_state(
       return false;
     }
 
+    // an image has no fill shade, so grown grids (and the chunks of a SPARSE
+    // grid) get the lowest ruled shade
+    for (u64 shade = 0; shade < state.rules.size(); ++shade) {
+      if (state.rules[shade].turn_dir != simulation::turn_direction::NIL) {
+        state.background_shade = u8(shade);
+        break;
+      }
+    }
+
+    if (seed_images != nullptr)
+      return try_to_set_grid_from_seed_image(state, img_path, *seed_images, layout, pages, grid_state, add_err, errors);
+
+    // RAW images are mapped rather than read, and become DENSE grids as they
+    // are, only copied page by page as the ant writes to them
+    b8 const view_as_grid = layout == simulation::grid_layout::DENSE && pages == simulation::huge_pages::OFF;
+    pgm8::mapped_image image{};
+    b8 mapped;
+    try {
+      mapped = pgm8::map_raw(img_path.string().c_str(), image, !view_as_grid);
+    } catch (std::runtime_error const &except) {
+      add_err(make_str("failed to read file \"%s\" - %s", grid_state.c_str(), except.what()));
+      return false;
+    }
+
+    if (mapped)
+      return try_to_set_grid_from_mapped_image(state, image, view_as_grid, layout, pages, grid_state, add_err, errors);
+
     std::ifstream file(img_path, std::ios::binary);
     if (!file) {
       add_err(make_str("unable to open file \"%s\"", grid_state.c_str()));
@@ -339,32 +709,41 @@ b8 try_to_parse_and_set_grid_state(
     }
 
     u64 const num_pixels = img_props.num_pixels();
-    {
-      u64 const num_pixels_expected = state.num_pixels();
-      if (num_pixels != num_pixels_expected) {
-        if (state.grid_width != img_props.get_width()) {
-          add_err(make_str("dimension mismatch, image width (%zu) does not correspond to grid width (%zu)",
-            img_props.get_width(), state.grid_width));
-        }
-        if (state.grid_height != img_props.get_height()){
-          add_err(make_str("dimension mismatch, image height (%zu) does not correspond to grid height (%zu)",
-            img_props.get_height(), state.grid_height));
-        }
-        return false;
-      }
-    }
+    if (!image_fits_grid(state, img_props, add_err))
+      return false;
 
-    try {
-      state.grid = new u8[num_pixels];
-    } catch (std::bad_alloc const &) {
+    if (!simulation::allocate_grid(state, layout, pages)) {
       add_err(make_str("unable to allocate %zu bytes for grid", num_pixels * sizeof(u8)));
       return false;
     }
 
+    std::array<b8, 256> shade_present{};
+    u64 const stride = u64(state.grid_stride());
     try {
-      pgm8::read_pixels(file, img_props, state.grid);
+      if (state.layout == simulation::grid_layout::SPARSE) {
+        // row by row, so the image never has to fit in memory and chunks of
+        // nothing but the lowest ruled shade are never committed
+        simulation::fill_grid(state, state.background_shade);
+        pgm8::read_rows(file, img_props, [&](u64 const row, u8 const *const pixels) {
+          for (u64 col = 0; col < u64(state.grid_width); ++col)
+            shade_present[pixels[col]] = true;
+          simulation::store_cells(state, 0, u32(row), u32(state.grid_width), 1, pixels, 0);
+        });
+      } else {
+        pgm8::read_pixels(file, img_props, state.grid, stride, state.bits_per_cell,
+          state.layout == simulation::grid_layout::TILED ? simulation::GRID_TILE_DIM : 0);
+        for (u64 row = 0; row < u64(state.grid_height); ++row)
+          for (u64 col = 0; col < u64(state.grid_width); ++col)
+            shade_present[state.get_cell((row * stride) + col)] = true;
+      }
     } catch (std::runtime_error const &except) {
       add_err(make_str("failed to read file \"%s\" - %s", grid_state.c_str(), except.what()));
+      simulation::free_grid(state);
+      return false;
+    }
+
+    if (!image_shades_ruled(state, shade_present, grid_state, add_err, errors)) {
+      simulation::free_grid(state);
       return false;
     }
 
@@ -375,7 +754,10 @@ b8 try_to_parse_and_set_grid_state(
 simulation::state simulation::parse_state(
   std::string const &str,
   fs::path const &dir,
-  errors_t &errors)
+  errors_t &errors,
+  simulation::grid_layout const layout,
+  simulation::huge_pages const pages,
+  simulation::seed_image_cache *const seed_images)
 {
   auto const add_err = [&errors](std::string &&err) {
     errors.emplace_back(err);
@@ -437,33 +819,41 @@ simulation::state simulation::parse_state(
   }
 
   b8 const grid_width_parse_success = try_to_parse_and_set_uint<i32>(
-    json, "grid_width", state.grid_width, 0, UINT16_MAX, add_err
+    json, "grid_width", state.grid_width, 0, simulation::MAX_GRID_DIM, add_err
   );
 
   b8 const grid_height_parse_success = try_to_parse_and_set_uint<i32>(
-    json, "grid_height", state.grid_height, 0, UINT16_MAX, add_err
+    json, "grid_height", state.grid_height, 0, simulation::MAX_GRID_DIM, add_err
   );
 
   b8 const ant_col_parse_success = try_to_parse_and_set_uint<i32>(
-  json, "ant_col", state.ant_col, 0, UINT16_MAX, add_err
+  json, "ant_col", state.ant_col, 0, simulation::MAX_GRID_DIM, add_err
   );
 
   b8 const ant_row_parse_success = try_to_parse_and_set_uint<i32>(
-    json, "ant_row", state.ant_row, 0, UINT16_MAX, add_err
+    json, "ant_row", state.ant_row, 0, simulation::MAX_GRID_DIM, add_err
   );
 
-  if (grid_width_parse_success && (state.grid_width < 1 || state.grid_width > UINT16_MAX)) {
-    add_err(make_str("bad grid_width, must be in range [1, %" PRIu16 "]", UINT16_MAX));
+  if (grid_width_parse_success && (state.grid_width < 1 || state.grid_width > simulation::MAX_GRID_DIM)) {
+    add_err(make_str("bad grid_width, must be in range [1, %d]", simulation::MAX_GRID_DIM));
   } else if (ant_col_parse_success && !util::in_range_incl_excl(state.ant_col, 0, state.grid_width)) {
     add_err(make_str("bad ant_col, not in grid x-axis [0, %d)", state.grid_width));
   }
 
-  if (grid_height_parse_success && (state.grid_height < 1 || state.grid_height > UINT16_MAX)) {
-    add_err(make_str("bad grid_height, must be in range [1, %" PRIu16 "]", UINT16_MAX));
+  if (grid_height_parse_success && (state.grid_height < 1 || state.grid_height > simulation::MAX_GRID_DIM)) {
+    add_err(make_str("bad grid_height, must be in range [1, %d]", simulation::MAX_GRID_DIM));
   } else if (ant_row_parse_success && !util::in_range_incl_excl(state.ant_row, 0, state.grid_height)) {
     add_err(make_str("bad ant_row, not in grid y-axis [0, %d)", state.grid_width));
   }
 
+  // only present once the grid has grown
+  if (json.count("origin_col") > 0) {
+    try_to_parse_and_set_uint<i32>(json, "origin_col", state.origin_col, 0, simulation::MAX_GRID_DIM, add_err);
+  }
+  if (json.count("origin_row") > 0) {
+    try_to_parse_and_set_uint<i32>(json, "origin_row", state.origin_row, 0, simulation::MAX_GRID_DIM, add_err);
+  }
+
   [[maybe_unused]] b8 const last_step_res_parse_success = try_to_parse_and_set_enum<
     simulation::step_result::value_type
   >(
@@ -497,8 +887,35 @@ simulation::state simulation::parse_state(
     json, state, add_err
   );
 
+  // optional, grids have edges unless told otherwise
+  if (json.count("boundary") > 0) {
+    b8 const boundary_parse_success = try_to_parse_and_set_enum<simulation::grid_boundary>(
+      json,
+      "boundary",
+      {
+        { "edge", simulation::grid_boundary::EDGE },
+        { "torus", simulation::grid_boundary::TORUS },
+      },
+      state.boundary,
+      add_err
+    );
+
+    if (
+      boundary_parse_success && state.boundary == simulation::grid_boundary::TORUS &&
+      grid_width_parse_success && grid_height_parse_success &&
+      (!std::has_single_bit(u32(state.grid_width)) || !std::has_single_bit(u32(state.grid_height)))
+    ) {
+      add_err("bad boundary, torus grid_width and grid_height must be powers of 2");
+    }
+  }
+
+  // a torus wraps around row by row, which only DENSE grids are laid out as
+  simulation::grid_layout const grid_layout = state.boundary == simulation::grid_boundary::TORUS
+    ? simulation::grid_layout::DENSE
+    : layout;
+
   [[maybe_unused]] b8 const grid_state_parse_success = try_to_parse_and_set_grid_state(
-    json, dir, state, add_err, errors
+    json, dir, state, add_err, errors, grid_layout, pages, seed_images
   );
 
   if (errors.empty()) {
@@ -1,11 +1,13 @@
 #include <cstdarg>
 #include <cstdio>
 #include <fstream>
+#include <memory>
 #include <functional>
 #include <regex>
 #include <sstream>
 #include <unordered_map>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 #include "simulation.hpp"
@@ -62,6 +64,77 @@ u64 idx_of_smallest(Ty const *const values, u64 const num_values)
   return min_idx;
 }
 
+enum class stop_reason : u64
+{
+  SAVE_INTERVAL = 0,
+  SAVE_POINT,
+  GENERATION_LIMIT,
+};
+
+struct stop
+{
+  u64 distance;
+  stop_reason reason;
+};
+
+// Works out where `run` stops next, `save_points` must be sorted in descending order.
+static
+stop compute_next_stop(
+  u64 const generation,
+  u64 const generation_limit,
+  std::vector<u64> const &save_points,
+  u64 const save_interval)
+{
+  // the most generations we can perform before we overflow state.generation
+  u64 const max_dist = UINT64_MAX - generation;
+
+  u64 const dist_to_next_save_interval =
+    save_interval == 0 ? max_dist : save_interval - (generation % save_interval);
+
+  u64 const dist_to_next_save_point =
+    save_points.empty() ? max_dist : save_points.back() - generation;
+
+  u64 const dist_to_gen_limit = generation_limit - generation;
+
+  std::array<u64, 3> const distances {
+    dist_to_next_save_interval,
+    dist_to_next_save_point,
+    dist_to_gen_limit,
+  };
+
+  u64 const idx_of_smallest_dist = idx_of_smallest(distances.data(), distances.size());
+  return {
+    distances[idx_of_smallest_dist],
+    static_cast<stop_reason>(idx_of_smallest_dist),
+  };
+}
+
+static
+void prepare_stops(std::vector<u64> &save_points, u64 &generation_limit)
+{
+  // sort save_points in descending order, so we can pop them off the back as we complete them
+  std::sort(save_points.begin(), save_points.end(), std::greater<u64>());
+  save_points = remove_duplicates_sorted(save_points);
+
+  if (generation_limit == 0) {
+    generation_limit = (UINT64_MAX - 1);
+  }
+}
+
+u64 simulation::generations_until_first_stop(
+  state const &state,
+  u64 generation_limit,
+  std::vector<u64> save_points,
+  u64 const save_interval)
+{
+  prepare_stops(save_points, generation_limit);
+
+  if (state.generation >= generation_limit)
+    return 0;
+
+  return compute_next_stop(state.generation, generation_limit, save_points, save_interval).distance;
+}
+
 simulation::run_result simulation::run(
   state &state,
   std::string const &name,
@@ -73,6 +146,7 @@ simulation::run_result simulation::run(
   b8 const save_final_cfg,
   b8 const create_logs,
   b8 const save_image_only,
+  engine_options const &engine,
   std::atomic<u64> *const num_sims_processed,
   u64 const total_num_of_sims)
 {
@@ -103,35 +177,34 @@ simulation::run_result simulation::run(
     return duration;
   };
 
-  auto const do_save = [&] {
-    bool success;
+  // saves handed to save threads finish whenever they do, so what they report
+  // back to is guarded, and `run` waits for them all before returning
+  std::mutex saves_mutex{};
+  std::condition_variable saves_cv{};
+  u64 num_saves_in_flight = 0;
 
-    try {
-      auto const save_res = simulation::save_state(state, name.c_str(), save_dir, img_fmt, save_image_only);
-      success = save_res.state_write_success && save_res.image_write_success;
-    } catch (...) {
-      success = false;
-    }
+  auto const finish_save = [&](b8 const success, u64 const generation) {
+    std::scoped_lock saves_lock(saves_mutex);
 
     if (success) {
       ++result.num_save_points_successful;
       s_num_consecutive_save_fails.store(0);
 
       if (create_logs) {
-        f64 const percent_of_gen_limit = (f64(state.generation) / f64(generation_limit)) * 100.0;
+        f64 const percent_of_gen_limit = (f64(generation) / f64(generation_limit)) * 100.0;
 
         log(event_type::SAVE_POINT, "%*.*s | %6.2lf %%, %zu",
-          MAX_SIM_NAME_DISPLAY_LEN, MAX_SIM_NAME_DISPLAY_LEN, name.c_str(), percent_of_gen_limit, state.generation);
+          MAX_SIM_NAME_DISPLAY_LEN, MAX_SIM_NAME_DISPLAY_LEN, name.c_str(), percent_of_gen_limit, generation);
       }
     } else {
       ++result.num_save_points_failed;
       ++s_num_consecutive_save_fails;
 
       if (create_logs) {
-        f64 const percent_of_gen_limit = (f64(state.generation) / f64(generation_limit)) * 100.0;
+        f64 const percent_of_gen_limit = (f64(generation) / f64(generation_limit)) * 100.0;
 
         log(event_type::ERROR, "%*.*s | %6.2lf %%, %zu, save point failed!",
-          MAX_SIM_NAME_DISPLAY_LEN, MAX_SIM_NAME_DISPLAY_LEN, name.c_str(), percent_of_gen_limit, state.generation);
+          MAX_SIM_NAME_DISPLAY_LEN, MAX_SIM_NAME_DISPLAY_LEN, name.c_str(), percent_of_gen_limit, generation);
       }
 
       {
@@ -147,58 +220,112 @@ simulation::run_result simulation::run(
     }
   };
 
-  // sort save_points in descending order, so we can pop them off the back as we complete them
-  std::sort(save_points.begin(), save_points.end(), std::greater<u64>());
-  save_points = remove_duplicates_sorted(save_points);
+  // with delta saves, the grid as of the last save
+  delta_base delta{};
+  delta.keyframe_interval = engine.keyframe_interval;
+  b8 const delta_saves = engine.keyframe_interval > 0;
+
+  auto const do_save = [&](b8 const final_save) {
+    if (engine.checkpoint_saves) {
+      bool success;
+      try {
+        success = simulation::save_checkpoint(state, name.c_str(), save_dir);
+      } catch (...) {
+        success = false;
+      }
+      finish_save(success, state.generation);
+      return;
+    }
+
+    // the last save is always a full image, so it can be used as is
+    b8 const last_save = final_save || state.generation >= generation_limit;
+    delta_base *const save_delta = delta_saves && !last_save ? &delta : nullptr;
+
+    {
+      std::scoped_lock saves_lock(saves_mutex);
+      ++num_saves_in_flight;
+    }
+
+    // a grid in a file is already as good as saved, copying it is all there
+    // is, and deltas need the grid as it is to be compared against
+    b8 const handed_over = state.file == nullptr && save_delta == nullptr && simulation::save_state_async(state, name, save_dir, img_fmt, save_image_only,
+      [&, generation = state.generation](save_state_result const &save_res) {
+        finish_save(save_res.state_write_success && save_res.image_write_success, generation);
+
+        std::scoped_lock saves_lock(saves_mutex);
+        --num_saves_in_flight;
+        saves_cv.notify_all();
+      });
+
+    if (handed_over)
+      return;
+
+    {
+      std::scoped_lock saves_lock(saves_mutex);
+      --num_saves_in_flight;
+    }
+
+    bool success;
+
+    try {
+      auto const save_res = simulation::save_state(state, name.c_str(), save_dir, img_fmt, save_image_only, final_save, save_delta);
+      success = save_res.state_write_success && save_res.image_write_success;
+    } catch (...) {
+      success = false;
+    }
+
+    finish_save(success, state.generation);
+  };
+
+  prepare_stops(save_points, generation_limit);
 
   u64 last_saved_gen = UINT64_MAX;
-  if (generation_limit == 0) {
-    generation_limit = (UINT64_MAX - 1);
-  }
 
   state.maxval = deduce_maxval_from_rules(state.rules);
 
-  if (state.generation >= generation_limit) {
-    result.code = run_result::code::REACHED_GENERATION_LIMIT;
-    goto done;
-  }
-
-  for (;;) {
-    // the most generations we can perform before we overflow state.generation
-    u64 const max_dist = UINT64_MAX - state.generation;
+  // a torus has no edges for windows, memoized tiles or highways to run into,
+  // so it's always stepped by its kernel alone
+  b8 const torus = state.boundary == grid_boundary::TORUS;
 
-    u64 const dist_to_next_save_interval =
-      save_interval == 0 ? max_dist : save_interval - (state.generation % save_interval);
+  auto const select_kernel = [&engine, torus](simulation::state const &s) {
+    return engine.engine == step_engine::WINDOW && !torus
+      ? select_window_kernel(s)
+      : select_step_kernel(s);
+  };
 
-    u64 const dist_to_next_save_point =
-      save_points.empty() ? max_dist : save_points.back() - state.generation;
+  // saves of the grid then only copy its file (or, for the final one, rename it)
+  auto const map_live_grid = [&] {
+    if (engine.live_grid_file && img_fmt == pgm8::format::RAW && fs::is_directory(save_dir))
+      map_grid_to_file(state, save_dir / (name + ".live.pgm"));
+  };
+  map_live_grid();
 
-    u64 const dist_to_gen_limit = generation_limit - state.generation;
+  // selected up front (and again whenever the grid grows), declared before the
+  // first `goto done` so we don't jump over it
+  step_kernel kernel = select_kernel(state);
 
-    std::array<u64, 3> const distances {
-      dist_to_next_save_interval,
-      dist_to_next_save_point,
-      dist_to_gen_limit,
-    };
+  // can be big, so only allocated if it's going to be used
+  std::unique_ptr<memo_table> const memo = engine.engine == step_engine::MEMO && !torus
+    ? std::make_unique<memo_table>(engine.memo_table_bytes)
+    : nullptr;
+  std::unique_ptr<highway_tracker> const highways = engine.fast_forward_highways && !torus
+    ? std::make_unique<highway_tracker>()
+    : nullptr;
 
-    enum class stop_reason : u64
-    {
-      SAVE_INTERVAL = 0,
-      SAVE_POINT,
-      GENERATION_LIMIT,
-    };
+  if (state.generation >= generation_limit) {
+    result.code = run_result::code::REACHED_GENERATION_LIMIT;
+    goto done;
+  }
 
-    struct stop
-    {
-      u64 distance;
-      stop_reason reason;
-    };
+  // a state saved facing the edge has already replaced its cell and turned,
+  // growing takes the rest of the step rather than stepping that cell again
+  if (state.last_step_res == step_result::HIT_EDGE && engine.max_grid_dim > 0 && grow_grid(state, engine.max_grid_dim)) {
+    map_live_grid();
+    kernel = select_kernel(state);
+  }
 
-    u64 const idx_of_smallest_dist = idx_of_smallest(distances.data(), distances.size());
-    stop const next_stop {
-      distances[idx_of_smallest_dist],
-      static_cast<stop_reason>(idx_of_smallest_dist),
-    };
+  for (;;) {
+    stop const next_stop = compute_next_stop(state.generation, generation_limit, save_points, save_interval);
 
     if (next_stop.reason == stop_reason::SAVE_POINT) {
       save_points.pop_back();
@@ -207,13 +334,27 @@ simulation::run_result simulation::run(
     if (next_stop.distance > 0) {
       begin_new_activity(activity::ITERATING);
 
-      for (u64 i = 0; i < next_stop.distance; ++i) {
-        state.last_step_res = simulation::attempt_step_forward(state);
-        if (state.last_step_res == simulation::step_result::SUCCESS) [[likely]] {
-          ++state.generation;
-        } else [[unlikely]] {
-          break;
+      // step in slices so that progress reporting (which reads state.generation
+      // from another thread) stays live during long stretches without saves
+      u64 const max_gens_per_slice = 1ull << 26;
+
+      for (u64 remaining = next_stop.distance; remaining > 0;) {
+        u64 const slice = std::min(remaining, max_gens_per_slice);
+        u64 const completed = highways != nullptr
+          ? simulation::step_forward_fast_forwarding_highways(state, kernel, memo.get(), *highways, slice)
+          : memo != nullptr
+          ? simulation::step_forward_memoized(state, kernel, *memo, slice)
+          : simulation::step_forward(state, kernel, slice);
+        if (completed < slice) [[unlikely]] {
+          // the ant is facing the edge, with the rest of its step held back
+          if (engine.max_grid_dim == 0 || !grow_grid(state, engine.max_grid_dim))
+            break;
+          map_live_grid();
+          kernel = select_kernel(state);
+          remaining -= completed + 1;
+          continue;
         }
+        remaining -= completed;
       }
 
       end_curr_activity();
@@ -228,7 +369,9 @@ simulation::run_result simulation::run(
 
     if (next_stop.reason == stop_reason::SAVE_POINT || next_stop.reason == stop_reason::SAVE_INTERVAL) {
       begin_new_activity(activity::SAVING);
-      do_save();
+      do_save(false);
+      // between stretches of stepping is the only time chunks can go
+      release_uniform_chunks(state);
       end_curr_activity();
       last_saved_gen = state.generation;
       u64 const save_duration_ns = compute_activity_duration_ns();
@@ -244,11 +387,21 @@ done:
   b8 const final_state_already_saved = last_saved_gen == state.generation;
   if (save_final_cfg && !final_state_already_saved) {
     begin_new_activity(activity::SAVING);
-    do_save();
+    do_save(true);
     end_curr_activity();
     u64 const save_duration_ns = compute_activity_duration_ns();
     state.nanos_spent_saving += save_duration_ns;
   }
+
+  {
+    std::unique_lock saves_lock(saves_mutex);
+    if (num_saves_in_flight > 0) {
+      begin_new_activity(activity::SAVING);
+      saves_cv.wait(saves_lock, [&] { return num_saves_in_flight == 0; });
+      end_curr_activity();
+      state.nanos_spent_saving += compute_activity_duration_ns();
+    }
+  }
   begin_new_activity(activity::NIL);
 
   if (create_logs) {
@@ -270,15 +423,46 @@ done:
       ( f64(simulation_number) / f64(total_num_of_sims) ) * 100.0
       : std::nan("percent_of_total");
 
+    std::string engine_desc = kernel.name;
+    if (memo != nullptr) {
+      memo_stats const &stats = memo->stats;
+      f64 const hit_rate = stats.lookups > 0 ? (f64(stats.hits) / f64(stats.lookups)) * 100.0 : 0.0;
+      f64 const kernel_share = state.generations_completed() > 0
+        ? (f64(stats.kernel_steps) / f64(state.generations_completed())) * 100.0 : 0.0;
+      engine_desc += util::make_str(", memo %.2lf %% hits (%zu/%zu), %zu stores, %zu MiB table, %.2lf %% gens by kernel",
+        hit_rate, stats.hits, stats.lookups, stats.stores,
+        (memo->entries.size() * sizeof(memo_entry)) / (1024 * 1024), kernel_share);
+    }
+    if (state.layout == grid_layout::SPARSE) {
+      engine_desc += util::make_str(", %zu/%zu chunks committed",
+        state.sparse->committed.size(), state.sparse->num_chunks);
+    }
+    if (state.origin_col != 0 || state.origin_row != 0)
+      engine_desc += util::make_str(", grew to %dx%d", state.grid_width, state.grid_height);
+    engine_desc += util::make_str(", %.2lf MiB resident", f64(state.grid_resident_bytes()) / (1024.0 * 1024.0));
+    if (state.grid_pages == huge_pages::THP)
+      engine_desc += " (thp)";
+    else if (state.grid_pages == huge_pages::HUGETLB)
+      engine_desc += " (hugetlb)";
+    if (highways != nullptr) {
+      if (highways->num_fast_forwards > 0)
+        engine_desc += util::make_str(", highway period %" PRIu32 " (%+" PRIi32 ", %+" PRIi32 "), %zu gens fast-forwarded in %zu jumps",
+          highways->period, highways->col_delta, highways->row_delta,
+          highways->gens_fast_forwarded, highways->num_fast_forwards);
+      else
+        engine_desc += ", no highway";
+    }
+
     if (create_logs)
-      log(event_type::SIM_END, "%*.*s | (%*zu/%zu, %6.2lf %%) %6.2lf Mgens/s, %-18s",
+      log(event_type::SIM_END, "%*.*s | (%*zu/%zu, %6.2lf %%) %6.2lf Mgens/s, %-18s, %s",
         MAX_SIM_NAME_DISPLAY_LEN, MAX_SIM_NAME_DISPLAY_LEN,
         name.c_str(),
         num_digits_in_total, simulation_number,
         total_num_of_sims,
         percent_of_total,
         mega_gens_per_sec,
-        result_cstr);
+        result_cstr,
+        engine_desc.c_str());
   }
 
   return result;
@@ -287,8 +471,8 @@ done:
 simulation::step_result::value_type simulation::attempt_step_forward(
   simulation::state &state)
 {
-  u64 const curr_cell_idx = (u64(state.ant_row) * u64(state.grid_width)) + u64(state.ant_col);
-  u8 const curr_cell_shade = state.grid[curr_cell_idx];
+  u64 const curr_cell_idx = (u64(state.ant_row) * u64(state.grid_stride())) + u64(state.ant_col);
+  u8 const curr_cell_shade = state.get_cell(curr_cell_idx);
   auto const &curr_cell_rule = state.rules[curr_cell_shade];
 
   // turn
@@ -299,7 +483,7 @@ simulation::step_result::value_type simulation::attempt_step_forward(
     state.ant_orientation = orientation::NORTH;
 
   // update current cell shade
-  state.grid[curr_cell_idx] = curr_cell_rule.replacement_shade;
+  state.set_cell(curr_cell_idx, curr_cell_rule.replacement_shade);
 
   i32 next_col, next_row;
 #if 0
@@ -332,6 +516,12 @@ simulation::step_result::value_type simulation::attempt_step_forward(
     next_row = state.ant_row;
 #endif
 
+  if (state.boundary == grid_boundary::TORUS) {
+    state.ant_col = (next_col + state.grid_width) % state.grid_width;
+    state.ant_row = (next_row + state.grid_height) % state.grid_height;
+    return step_result::SUCCESS;
+  }
+
   if (
     util::in_range_incl_excl(next_col, 0, state.grid_width) &&
     util::in_range_incl_excl(next_row, 0, state.grid_height)) [[likely]] {
@@ -1,3 +1,9 @@
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include "simulation.hpp"
 #include "json.hpp"
 #include "logger.hpp"
@@ -6,12 +12,42 @@ namespace fs = std::filesystem;
 using json_t = nlohmann::json;
 using util::make_str;
 
+// A copy of a grid's cells, row by row, for a save thread to write.
+struct save_buffer
+{
+  std::unique_ptr<u8[]> cells;
+  u64 size;
+};
+
+struct save_job
+{
+  simulation::state snapshot; // DENSE, its grid being `buffer`
+  save_buffer buffer;
+  std::string name;
+  fs::path save_dir;
+  pgm8::format img_fmt;
+  b8 image_only;
+  std::function<void (simulation::save_state_result)> on_done;
+};
+
+static std::mutex s_save_mutex{};
+static std::condition_variable s_save_job_cv{}; // a job was queued, or the threads are stopping
+static std::condition_variable s_save_space_cv{}; // a buffer was handed back
+static std::vector<std::thread> s_save_threads{};
+static std::deque<save_job> s_save_jobs{};
+static std::vector<save_buffer> s_idle_save_buffers{};
+static u64 s_save_buffer_bytes_held = 0; // idle buffers and those of queued jobs
+static u64 s_max_save_buffer_bytes = 0;
+static b8 s_save_threads_stopping = false;
+
 simulation::save_state_result simulation::save_state(
   simulation::state const &state,
   const char *const name,
   fs::path const &save_dir,
   pgm8::format const fmt,
-  b8 const image_only)
+  b8 const image_only,
+  b8 const final_save,
+  delta_base *const delta)
 {
   if (!fs::is_directory(save_dir)) {
     throw std::runtime_error(make_str("save_dir '%s' is not a directory", save_dir.generic_string().c_str()));
@@ -32,7 +68,7 @@ simulation::save_state_result simulation::save_state(
     result.state_write_success = print_state_json(
       state_file,
       state_file_path_str,
-      name_with_gen + ".pgm",
+      name_with_gen + pgm8::file_extension(fmt),
       state.generation,
       state.grid_width,
       state.grid_height,
@@ -41,7 +77,10 @@ simulation::save_state_result simulation::save_state(
       state.last_step_res,
       state.ant_orientation,
       util::count_digits(state.maxval),
-      state.rules);
+      state.rules,
+      state.origin_col,
+      state.origin_row,
+      state.boundary);
   } else {
     // we aren't writing a state file, so consider it a success
     result.state_write_success = true;
@@ -54,14 +93,86 @@ simulation::save_state_result simulation::save_state(
   {
     pgm8::image_properties img_props;
     img_props.set_format(fmt);
-    img_props.set_width(static_cast<u16>(state.grid_width));
-    img_props.set_height(static_cast<u16>(state.grid_height));
+    img_props.set_width(static_cast<u32>(state.grid_width));
+    img_props.set_height(static_cast<u32>(state.grid_height));
     img_props.set_maxval(state.maxval);
 
-    file_path.replace_extension(".pgm");
-    std::string const img_path_str = file_path.generic_string();
-    std::fstream img_file = util::open_file(img_path_str, std::ios::out);
-    b8 const success = pgm8::write(img_file, img_props, state.grid);
+    file_path.replace_extension(pgm8::file_extension(fmt));
+    b8 success;
+
+    b8 const write_as_delta = delta != nullptr
+      && !delta->cells.empty()
+      && delta->grid_width == state.grid_width
+      && delta->grid_height == state.grid_height
+      && delta->num_deltas + 1 < delta->keyframe_interval;
+
+    if (write_as_delta) {
+      file_path.replace_extension(".delta");
+      success = write_delta(state, *delta, file_path);
+      ++delta->num_deltas;
+    } else if (state.file != nullptr && fmt == pgm8::format::RAW) {
+      // the file already is the image, the final save can even have it
+      success = save_grid_file(state, file_path, final_save);
+    } else {
+      // written beside the image and renamed over it, as the grid (or another
+      // state's) may be a private mapping of the image, see `parse_state`,
+      // which truncating it would pull out from under
+      fs::path const img_path = file_path;
+      file_path += ".tmp";
+      std::fstream img_file = util::open_file(file_path.generic_string(), std::ios::out);
+
+      if (state.layout == grid_layout::SPARSE) {
+        // chunks which were never written to are made up on the fly
+        u64 const dim = GRID_TILE_DIM;
+        u64 const chunks_per_row = (u64(state.grid_width) + dim - 1) / dim;
+        sparse_chunks const &sparse = *state.sparse;
+
+        success = pgm8::write_rows(img_file, img_props, [&](size_t const row, u8 *const pixels) {
+          for (u64 col = 0; col < u64(state.grid_width); col += dim) {
+            u8 const *const chunk = sparse.chunks[((row / dim) * chunks_per_row) + (col / dim)];
+            u64 const len = std::min(dim, u64(state.grid_width) - col);
+            if (chunk == nullptr)
+              std::fill_n(pixels + col, len, sparse.fill_shade);
+            else
+              std::copy_n(chunk + ((row % dim) * dim), len, pixels + col);
+          }
+        });
+      } else if (state.shade_remap != 0) {
+        // cells are stored remapped, see fill_grid
+        u64 const width = u64(state.grid_width);
+        success = pgm8::write_rows(img_file, img_props, [&](size_t const row, u8 *const pixels) {
+          u64 const first_idx = row * width;
+          if (state.layout == grid_layout::DENSE) {
+            for (u64 col = 0; col < width; ++col)
+              pixels[col] = u8(state.grid[first_idx + col] ^ state.shade_remap);
+          } else {
+            for (u64 col = 0; col < width; ++col)
+              pixels[col] = state.get_cell(first_idx + col);
+          }
+        });
+      } else {
+        success = pgm8::write(img_file, img_props, state.grid, size_t(state.grid_stride()), state.bits_per_cell,
+          state.layout == grid_layout::TILED ? GRID_TILE_DIM : 0);
+      }
+
+      img_file.close();
+      success = success && !img_file.fail();
+      if (success) {
+        std::error_code ec;
+        fs::rename(file_path, img_path, ec);
+        success = !ec;
+      }
+      // on failure the temporary file goes, the image stays as it was
+      if (success)
+        file_path = img_path;
+    }
+
+    if (delta != nullptr) {
+      if (!success)
+        delta->cells.clear(); // next save is a full image, whatever state the base is in
+      else if (!write_as_delta)
+        set_delta_base(state, *delta);
+    }
 
     result.image_write_success = success;
   }
@@ -72,6 +183,150 @@ simulation::save_state_result simulation::save_state(
   return result;
 }
 
+static
+void save_thread_loop()
+{
+  for (;;) {
+    save_job job;
+    {
+      std::unique_lock lock(s_save_mutex);
+      s_save_job_cv.wait(lock, [] { return !s_save_jobs.empty() || s_save_threads_stopping; });
+      if (s_save_jobs.empty())
+        return;
+      job = std::move(s_save_jobs.front());
+      s_save_jobs.pop_front();
+    }
+
+    simulation::save_state_result result{};
+    try {
+      result = simulation::save_state(job.snapshot, job.name.c_str(), job.save_dir, job.img_fmt, job.image_only);
+    } catch (...) {
+      result = {};
+    }
+
+    {
+      std::scoped_lock lock(s_save_mutex);
+      s_idle_save_buffers.push_back(std::move(job.buffer));
+    }
+    s_save_space_cv.notify_all();
+
+    job.on_done(result);
+  }
+}
+
+void simulation::start_save_threads(u64 const num_threads, u64 const max_buffer_bytes)
+{
+  std::scoped_lock lock(s_save_mutex);
+  assert(s_save_threads.empty());
+
+  s_max_save_buffer_bytes = max_buffer_bytes;
+  s_save_threads_stopping = false;
+  for (u64 i = 0; i < num_threads; ++i)
+    s_save_threads.emplace_back(save_thread_loop);
+}
+
+void simulation::stop_save_threads()
+{
+  {
+    std::scoped_lock lock(s_save_mutex);
+    s_save_threads_stopping = true;
+  }
+  s_save_job_cv.notify_all();
+
+  for (auto &thread : s_save_threads)
+    thread.join();
+
+  std::scoped_lock lock(s_save_mutex);
+  s_save_threads.clear();
+  s_idle_save_buffers.clear();
+  s_save_buffer_bytes_held = 0;
+}
+
+// A buffer of at least `size` bytes, reusing an idle one if possible. Blocks
+// until enough buffers are handed back to stay within the limit.
+static
+save_buffer acquire_save_buffer(std::unique_lock<std::mutex> &lock, u64 const size)
+{
+  for (;;) {
+    auto const fits = std::find_if(s_idle_save_buffers.begin(), s_idle_save_buffers.end(),
+      [size](save_buffer const &buffer) { return buffer.size >= size; });
+
+    if (fits != s_idle_save_buffers.end()) {
+      save_buffer buffer = std::move(*fits);
+      s_idle_save_buffers.erase(fits);
+      return buffer;
+    }
+
+    if (s_save_buffer_bytes_held + size <= s_max_save_buffer_bytes) {
+      s_save_buffer_bytes_held += size;
+      return { std::unique_ptr<u8[]>(new u8[size]), size };
+    }
+
+    // idle buffers too small to reuse make room for a new one
+    if (!s_idle_save_buffers.empty()) {
+      s_save_buffer_bytes_held -= s_idle_save_buffers.back().size;
+      s_idle_save_buffers.pop_back();
+      continue;
+    }
+
+    s_save_space_cv.wait(lock);
+  }
+}
+
+b8 simulation::save_state_async(
+  simulation::state const &state,
+  std::string const &name,
+  fs::path const &save_dir,
+  pgm8::format const img_fmt,
+  b8 const image_only,
+  std::function<void (save_state_result)> on_done)
+{
+  u64 const num_cells = state.num_pixels();
+
+  save_job job{};
+  {
+    std::unique_lock lock(s_save_mutex);
+    if (s_save_threads.empty() || num_cells > s_max_save_buffer_bytes)
+      return false;
+
+    try {
+      job.buffer = acquire_save_buffer(lock, num_cells);
+    } catch (std::bad_alloc const &) {
+      return false;
+    }
+  }
+
+  u32 const width = u32(state.grid_width);
+  load_cells(state, 0, 0, width, u32(state.grid_height), job.buffer.cells.get(), width);
+  if (state.shade_remap != 0) {
+    // cells are stored remapped, see fill_grid
+    for (u64 i = 0; i < num_cells; ++i)
+      job.buffer.cells[i] ^= state.shade_remap;
+  }
+
+  job.snapshot = state;
+  job.snapshot.layout = grid_layout::DENSE;
+  job.snapshot.grid = job.buffer.cells.get();
+  job.snapshot.sparse = nullptr;
+  job.snapshot.file = nullptr;
+  job.snapshot.bits_per_cell = 8;
+  job.snapshot.shade_remap = 0;
+  job.snapshot.grid_pages = huge_pages::OFF;
+  job.name = name;
+  job.save_dir = save_dir;
+  job.img_fmt = img_fmt;
+  job.image_only = image_only;
+  job.on_done = std::move(on_done);
+
+  {
+    std::scoped_lock lock(s_save_mutex);
+    s_save_jobs.push_back(std::move(job));
+  }
+  s_save_job_cv.notify_one();
+
+  return true;
+}
+
 bool simulation::print_state_json(
   std::ostream &os,
   std::string const &file_path,
@@ -84,7 +339,10 @@ bool simulation::print_state_json(
   step_result::value_type const last_step_res,
   orientation::value_type const ant_orientation,
   u64 const maxval_digits,
-  rules_t const &rules)
+  rules_t const &rules,
+  i32 const origin_col,
+  i32 const origin_row,
+  grid_boundary const boundary)
 {
   using logger::log;
   using logger::event_type;
@@ -97,11 +355,30 @@ bool simulation::print_state_json(
     << "  \"grid_width\": " << grid_width << ",\n"
     << "  \"grid_height\": " << grid_height << ",\n"
     << "  \"grid_state\": \"" << fs::path(grid_state).generic_string() << "\",\n"
+  ;
+
+  // edges are the default, only a torus says so
+  if (boundary == grid_boundary::TORUS)
+    os << "  \"boundary\": \"torus\",\n";
+
+  os
     << "\n"
     << "  \"ant_col\": " << ant_col << ",\n"
     << "  \"ant_row\": " << ant_row << ",\n"
     << "  \"ant_orientation\": \"" << simulation::orientation::to_cstr(ant_orientation) << "\",\n"
     << "\n"
+  ;
+
+  // only grown grids have their origin anywhere but the top left
+  if (origin_col != 0 || origin_row != 0) {
+    os
+      << "  \"origin_col\": " << origin_col << ",\n"
+      << "  \"origin_row\": " << origin_row << ",\n"
+      << "\n"
+    ;
+  }
+
+  os
     << "  \"rules\": [\n"
   ;
 
@@ -0,0 +1,878 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+#include "simulation.hpp"
+
+// Makes the movement part of a transition: moving one cell in the direction of
+// `orient_idx` (0 = N, clockwise), with no replacement shade filled in.
+static
+simulation::transition make_movement(u8 const orient_idx, i32 const grid_stride)
+{
+  i8 const col_deltas[4] { 0, 1, 0, -1 };
+  i8 const row_deltas[4] { -1, 0, 1, 0 };
+
+  i8 const col_delta = col_deltas[orient_idx];
+  i8 const row_delta = row_deltas[orient_idx];
+
+  return { (row_delta * grid_stride) + col_delta, col_delta, row_delta, 0, orient_idx };
+}
+
+simulation::transition_table_t simulation::compile_rules(
+  rules_t const &rules,
+  i32 const grid_stride,
+  u8 const shade_remap)
+{
+  transition_table_t table{};
+
+  for (u32 shade = 0; shade < 256; ++shade) {
+    auto const &rule = rules[shade];
+
+    // shades without a governing rule never make it into a parsed grid,
+    // wrap them around like any other turn so the table stays well-formed
+    i32 const turn = rule.turn_dir == turn_direction::NIL ? 2 : rule.turn_dir;
+
+    for (i32 orient_idx = 0; orient_idx < 4; ++orient_idx) {
+      u8 const new_orient_idx = static_cast<u8>((orient_idx + turn + 4) % 4);
+
+      transition t = make_movement(new_orient_idx, grid_stride);
+      t.replacement_shade = u8(rule.replacement_shade ^ shade_remap);
+
+      table[((shade ^ shade_remap) << 2) | u32(orient_idx)] = t;
+    }
+  }
+
+  return table;
+}
+
+// Looks up everything about a step in the compiled transition table. Shades are
+// masked so the compiler knows lookups can't leave the first NumShades rows.
+template <u32 NumShades>
+struct table_rules
+{
+  simulation::transition const *table;
+
+  explicit table_rules(simulation::step_kernel const &kernel)
+    : table{kernel.transitions.data()}
+  {}
+
+  simulation::transition apply(u32 const shade, u32 const orient_idx) const noexcept
+  {
+    return table[((shade & (NumShades - 1)) << 2) | orient_idx];
+  }
+};
+
+// Computes turns and replacements for rules forming the canonical cyclic chain,
+// where shade N is replaced with (N + 1) % num_rules. Turns come from bitmasks
+// held in registers, so the only lookup left is the 4-entry movement for the
+// new orientation.
+template <u32 NumShades, b8 HasNoTurn>
+struct cyclic_rules
+{
+  u64 right_turn_mask;
+  u64 no_turn_mask;
+  u32 num_rules;
+  // the movement part of a transition for each orientation, N E S W
+  simulation::transition movements[4];
+
+  explicit cyclic_rules(simulation::step_kernel const &kernel)
+    : right_turn_mask{kernel.right_turn_mask},
+      no_turn_mask{kernel.no_turn_mask},
+      num_rules{kernel.num_rules}
+  {
+    for (u8 orient_idx = 0; orient_idx < 4; ++orient_idx)
+      movements[orient_idx] = make_movement(orient_idx, kernel.row_stride);
+  }
+
+  static_assert(NumShades <= 64, "turn masks must fit in a single register");
+
+  static u32 test_bit(u64 const mask, u32 const shade) noexcept
+  {
+    return u32(mask >> shade) & 1;
+  }
+
+  simulation::transition apply(u32 const shade, u32 const orient_idx) const noexcept
+  {
+    // left is 3 clockwise quarter turns, right is 1
+    u32 turn = 3 - (test_bit(right_turn_mask, shade) << 1);
+    if constexpr (HasNoTurn)
+      turn &= test_bit(no_turn_mask, shade) - 1;
+
+    simulation::transition t = movements[(orient_idx + turn) & 3];
+
+    if constexpr (NumShades == 2) {
+      t.replacement_shade = u8(shade ^ 1);
+    } else {
+      u32 const next = shade + 1;
+      t.replacement_shade = u8(next == num_rules ? 0 : next);
+    }
+
+    return t;
+  }
+};
+
+// Reads cell `idx` of a grid with `CellBits` bits per cell, see grid_layout::PACKED.
+template <u32 CellBits>
+u32 load_cell(u8 const *const grid, u64 const idx) noexcept
+{
+  if constexpr (CellBits == 8) {
+    return grid[idx];
+  } else {
+    u64 const cells_per_byte = 8 / CellBits;
+    u32 const shift = u32(idx % cells_per_byte) * CellBits;
+    return (u32(grid[idx / cells_per_byte]) >> shift) & ((1u << CellBits) - 1);
+  }
+}
+
+template <u32 CellBits>
+void store_cell(u8 *const grid, u64 const idx, u8 const shade) noexcept
+{
+  if constexpr (CellBits == 8) {
+    grid[idx] = shade;
+  } else {
+    u64 const cells_per_byte = 8 / CellBits;
+    u32 const shift = u32(idx % cells_per_byte) * CellBits;
+    u32 const mask = ((1u << CellBits) - 1) << shift;
+    u8 &byte = grid[idx / cells_per_byte];
+    byte = u8((u32(byte) & ~mask) | (u32(shade) << shift));
+  }
+}
+
+// Steps through a DENSE or PACKED grid. The ant moves at most 1 cell per generation, so
+// from (col, row) it can't leave the grid in fewer than
+// min(col, width - 1 - col, row, height - 1 - row) steps. That many steps are
+// taken in an unrolled burst tracking nothing but idx, and col and row are
+// recovered afterwards. Only steps taken right next to an edge are checked.
+template <typename RulesTy, b8 PowTwoWidth, u32 CellBits = 8>
+u64 step_kernel_impl(
+  simulation::state &state,
+  simulation::step_kernel const &kernel,
+  u64 const max_steps)
+{
+  using namespace simulation;
+
+  RulesTy const rules(kernel);
+
+  u8 *const grid = state.grid;
+  u32 const width = u32(state.grid_width);
+  u32 const height = u32(state.grid_height);
+  u32 const width_shift = kernel.width_shift;
+  u32 const width_mask = width - 1;
+
+  u32 col = u32(state.ant_col);
+  u32 row = u32(state.ant_row);
+  u32 orient_idx = u32(state.ant_orientation - orientation::NORTH);
+  u64 idx;
+  if constexpr (PowTwoWidth)
+    idx = (u64(row) << width_shift) | col;
+  else
+    idx = (u64(row) * u64(width)) + u64(col);
+
+  u64 steps_taken = 0;
+  b8 hit_edge = false;
+
+  auto const step_unchecked = [&]() {
+    transition const t = rules.apply(load_cell<CellBits>(grid, idx), orient_idx);
+    store_cell<CellBits>(grid, idx, t.replacement_shade);
+    orient_idx = t.orientation_idx;
+    idx += u64(i64(t.idx_delta));
+  };
+
+  while (steps_taken < max_steps) {
+    u32 const margin = std::min({ col, width - 1 - col, row, height - 1 - row });
+
+    if (margin == 0) {
+      transition const t = rules.apply(load_cell<CellBits>(grid, idx), orient_idx);
+
+      store_cell<CellBits>(grid, idx, t.replacement_shade);
+      orient_idx = t.orientation_idx;
+
+      // casting to unsigned makes -1 wrap around to a huge value,
+      // so each axis only needs a single comparison
+      u32 const next_col = col + u32(i32(t.col_delta));
+      u32 const next_row = row + u32(i32(t.row_delta));
+
+      if (next_col >= width || next_row >= height) [[unlikely]] {
+        hit_edge = true;
+        break;
+      }
+
+      col = next_col;
+      row = next_row;
+      idx += u64(i64(t.idx_delta));
+      ++steps_taken;
+      continue;
+    }
+
+    u64 burst = std::min(u64(margin), max_steps - steps_taken);
+    steps_taken += burst;
+
+    for (; burst >= 4; burst -= 4) {
+      step_unchecked();
+      step_unchecked();
+      step_unchecked();
+      step_unchecked();
+    }
+    for (; burst > 0; --burst)
+      step_unchecked();
+
+    if constexpr (PowTwoWidth) {
+      col = u32(idx) & width_mask;
+      row = u32(idx >> width_shift);
+    } else {
+      col = u32(idx % width);
+      row = u32(idx / width);
+    }
+  }
+
+  state.ant_col = i32(col);
+  state.ant_row = i32(row);
+  state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+  state.generation += steps_taken;
+
+  if (hit_edge)
+    state.last_step_res = step_result::HIT_EDGE;
+  else if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
+
+// Steps through a TILED grid like `step_kernel_impl` does through a DENSE one,
+// except margins are measured to the edges of the ant's tile, which are all it
+// has to check on its way through. Leaving a tile is where the edge of the grid
+// gets checked, and the neighbouring tile gets looked up, which for a SPARSE
+// grid is where its chunk gets committed.
+template <typename RulesTy, b8 Sparse>
+u64 tiled_kernel_impl(
+  simulation::state &state,
+  simulation::step_kernel const &kernel,
+  u64 const max_steps)
+{
+  using namespace simulation;
+
+  RulesTy const rules(kernel);
+
+  u32 const dim = GRID_TILE_DIM;
+  u32 const dim_shift = u32(std::countr_zero(dim));
+  u32 const width = u32(state.grid_width);
+  u32 const height = u32(state.grid_height);
+  u64 const tiles_per_row = (u64(width) + dim - 1) / dim;
+
+  u32 col = u32(state.ant_col);
+  u32 row = u32(state.ant_row);
+  u32 orient_idx = u32(state.ant_orientation - orientation::NORTH);
+
+  // the ant's tile: its top left cell, its size once clipped to the grid,
+  // and where its cells start
+  u32 tile_col, tile_row, tile_width, tile_height;
+  u8 *tile;
+  auto const enter_tile = [&]() {
+    tile_col = col & ~(dim - 1);
+    tile_row = row & ~(dim - 1);
+    tile_width = std::min(dim, width - tile_col);
+    tile_height = std::min(dim, height - tile_row);
+    u64 const tile_idx = ((u64(tile_row) >> dim_shift) * tiles_per_row) + (tile_col >> dim_shift);
+    if constexpr (Sparse) {
+      tile = state.sparse->chunks[tile_idx];
+      if (tile == nullptr)
+        tile = commit_chunk(*state.sparse, tile_idx);
+    } else {
+      tile = state.grid + (tile_idx << (2 * dim_shift));
+    }
+  };
+  enter_tile();
+
+  u32 pos = ((row - tile_row) << dim_shift) | (col - tile_col);
+
+  u64 steps_taken = 0;
+  b8 hit_edge = false;
+
+  auto const step_unchecked = [&]() {
+    transition const t = rules.apply(tile[pos], orient_idx);
+    tile[pos] = t.replacement_shade;
+    orient_idx = t.orientation_idx;
+    pos += u32(t.idx_delta);
+  };
+
+  while (steps_taken < max_steps) {
+    u32 const local_col = pos & (dim - 1);
+    u32 const local_row = pos >> dim_shift;
+    u32 const margin = std::min({ local_col, tile_width - 1 - local_col, local_row, tile_height - 1 - local_row });
+
+    if (margin == 0) {
+      transition const t = rules.apply(tile[pos], orient_idx);
+
+      tile[pos] = t.replacement_shade;
+      orient_idx = t.orientation_idx;
+
+      u32 const next_local_col = local_col + u32(i32(t.col_delta));
+      u32 const next_local_row = local_row + u32(i32(t.row_delta));
+
+      if (next_local_col < tile_width && next_local_row < tile_height) {
+        pos += u32(t.idx_delta);
+        ++steps_taken;
+        continue;
+      }
+
+      // casting to unsigned makes -1 wrap around to a huge value,
+      // so each axis only needs a single comparison
+      u32 const next_col = tile_col + next_local_col;
+      u32 const next_row = tile_row + next_local_row;
+
+      if (next_col >= width || next_row >= height) [[unlikely]] {
+        hit_edge = true;
+        break;
+      }
+
+      col = next_col;
+      row = next_row;
+      enter_tile();
+      pos = ((row - tile_row) << dim_shift) | (col - tile_col);
+      ++steps_taken;
+      continue;
+    }
+
+    u64 burst = std::min(u64(margin), max_steps - steps_taken);
+    steps_taken += burst;
+
+    for (; burst >= 4; burst -= 4) {
+      step_unchecked();
+      step_unchecked();
+      step_unchecked();
+      step_unchecked();
+    }
+    for (; burst > 0; --burst)
+      step_unchecked();
+  }
+
+  state.ant_col = i32(tile_col + (pos & (dim - 1)));
+  state.ant_row = i32(tile_row + (pos >> dim_shift));
+  state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+  state.generation += steps_taken;
+
+  if (hit_edge)
+    state.last_step_res = step_result::HIT_EDGE;
+  else if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
+
+// How many steps sentinel kernels take between checking whether the ant is
+// on the border, every step past the edge is wasted going nowhere.
+static u64 const s_sentinel_check_interval = 4096;
+
+// Steps through a BORDERED grid without any bounds checks. The sentinel's table
+// entries leave the ant where it is, so an ant which walks onto the border gets
+// stuck there until the next check notices and backs it out. Moves are counted
+// as they happen, so the exact generation it walked off at is known.
+template <u32 NumShades>
+u64 sentinel_kernel_impl(
+  simulation::state &state,
+  simulation::step_kernel const &kernel,
+  u64 const max_steps)
+{
+  using namespace simulation;
+
+  table_rules<NumShades> const rules(kernel);
+
+  u8 *const grid = state.grid;
+  i64 const stride = state.grid_stride();
+  u8 const sentinel = kernel.sentinel_shade;
+
+  u32 orient_idx = u32(state.ant_orientation - orientation::NORTH);
+  i64 idx = (i64(state.ant_row) * stride) + i64(state.ant_col);
+
+  u64 steps_taken = 0;
+  b8 hit_edge = false;
+
+  while (steps_taken < max_steps) {
+    u64 const burst = std::min(max_steps - steps_taken, s_sentinel_check_interval);
+    u64 moves = 0;
+
+    for (u64 i = 0; i < burst; ++i) {
+      transition const t = rules.apply(grid[idx], orient_idx);
+      grid[idx] = t.replacement_shade;
+      orient_idx = t.orientation_idx;
+      idx += t.idx_delta;
+      moves += u64(t.idx_delta != 0);
+    }
+
+    steps_taken += moves;
+
+    if (grid[idx] == sentinel) [[unlikely]] {
+      // the move onto the border doesn't count as a generation,
+      // the ant stays where it was, turned and having replaced its cell
+      idx -= make_movement(u8(orient_idx), i32(stride)).idx_delta;
+      --steps_taken;
+      hit_edge = true;
+      break;
+    }
+  }
+
+  state.ant_col = i32(idx % stride);
+  state.ant_row = i32(idx / stride);
+  state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+  state.generation += steps_taken;
+
+  if (hit_edge)
+    state.last_step_res = step_result::HIT_EDGE;
+  else if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
+
+// Steps through a TORUS grid, which is DENSE with power of 2 dimensions. Like
+// `step_kernel_impl`, steps at least `margin` cells away from the edges are
+// taken in unchecked bursts. Steps right next to an edge wrap around instead
+// of checking anything: the column and row parts of the move are added to idx
+// separately, each masked to its own bits.
+template <typename RulesTy>
+u64 torus_kernel_impl(
+  simulation::state &state,
+  simulation::step_kernel const &kernel,
+  u64 const max_steps)
+{
+  using namespace simulation;
+
+  RulesTy const rules(kernel);
+
+  u8 *const grid = state.grid;
+  u32 const width = u32(state.grid_width);
+  u32 const height = u32(state.grid_height);
+  u32 const width_shift = kernel.width_shift;
+  u64 const col_mask = u64(width) - 1;
+  u64 const row_mask = (state.num_pixels() - 1) & ~col_mask;
+
+  u32 col = u32(state.ant_col);
+  u32 row = u32(state.ant_row);
+  u32 orient_idx = u32(state.ant_orientation - orientation::NORTH);
+  u64 idx = (u64(row) << width_shift) | col;
+
+  auto const step_unchecked = [&]() {
+    transition const t = rules.apply(grid[idx], orient_idx);
+    grid[idx] = t.replacement_shade;
+    orient_idx = t.orientation_idx;
+    idx += u64(i64(t.idx_delta));
+  };
+
+  u64 steps_taken = 0;
+
+  while (steps_taken < max_steps) {
+    u32 const margin = std::min({ col, width - 1 - col, row, height - 1 - row });
+
+    if (margin == 0) {
+      transition const t = rules.apply(grid[idx], orient_idx);
+      grid[idx] = t.replacement_shade;
+      orient_idx = t.orientation_idx;
+      // the row part of a move is a whole number of rows, so it never carries
+      // into or out of the column bits
+      u64 const col_part = (idx + u64(i64(t.col_delta))) & col_mask;
+      u64 const row_part = (idx + u64(i64(t.idx_delta - t.col_delta))) & row_mask;
+      idx = col_part | row_part;
+      ++steps_taken;
+    } else {
+      u64 burst = std::min(u64(margin), max_steps - steps_taken);
+      steps_taken += burst;
+
+      for (; burst >= 4; burst -= 4) {
+        step_unchecked();
+        step_unchecked();
+        step_unchecked();
+        step_unchecked();
+      }
+      for (; burst > 0; --burst)
+        step_unchecked();
+    }
+
+    col = u32(idx & col_mask);
+    row = u32(idx >> width_shift);
+  }
+
+  state.ant_col = i32(col);
+  state.ant_row = i32(row);
+  state.ant_orientation = static_cast<orientation::value_type>(orientation::NORTH + i32(orient_idx));
+  state.generation += steps_taken;
+
+  if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
+
+// Rounds the number of shades in play up to one of the kernel buckets: 2, 4, 16 or 256.
+static
+u32 shade_bucket(u32 const num_shades)
+{
+  if (num_shades <= 2) return 2;
+  if (num_shades <= 4) return 4;
+  if (num_shades <= 16) return 16;
+  return 256;
+}
+
+// Appended to kernel names, empty for one byte per cell row by row.
+template <simulation::grid_layout Layout, u32 CellBits>
+char const *layout_suffix()
+{
+  using simulation::grid_layout;
+
+  if constexpr (Layout == grid_layout::TILED) return ",tiled";
+  else if constexpr (Layout == grid_layout::SPARSE) return ",sparse";
+  else if constexpr (CellBits == 1) return ",packed1";
+  else if constexpr (CellBits == 2) return ",packed2";
+  else if constexpr (CellBits == 4) return ",packed4";
+  else return "";
+}
+
+template <simulation::grid_layout Layout>
+constexpr b8 is_tiled()
+{
+  return Layout == simulation::grid_layout::TILED || Layout == simulation::grid_layout::SPARSE;
+}
+
+// Tiled kernels only ever multiply by the tile size, so they ignore PowTwoWidth.
+template <typename RulesTy, b8 PowTwoWidth, simulation::grid_layout Layout, u32 CellBits>
+void set_kernel_function(simulation::step_kernel &kernel)
+{
+  if constexpr (is_tiled<Layout>())
+    kernel.function = tiled_kernel_impl<RulesTy, Layout == simulation::grid_layout::SPARSE>;
+  else
+    kernel.function = step_kernel_impl<RulesTy, PowTwoWidth, CellBits>;
+}
+
+template <u32 NumShades, b8 PowTwoWidth, simulation::grid_layout Layout = simulation::grid_layout::DENSE, u32 CellBits = 8>
+void set_table_kernel(simulation::step_kernel &kernel)
+{
+  set_kernel_function<table_rules<NumShades>, PowTwoWidth, Layout, CellBits>(kernel);
+  std::snprintf(kernel.name, sizeof(kernel.name), "table%u%s%s",
+    NumShades, PowTwoWidth && !is_tiled<Layout>() ? ",pow2" : "", layout_suffix<Layout, CellBits>());
+}
+
+template <u32 NumShades, b8 HasNoTurn, b8 PowTwoWidth, simulation::grid_layout Layout = simulation::grid_layout::DENSE, u32 CellBits = 8>
+void set_cyclic_kernel(simulation::step_kernel &kernel)
+{
+  set_kernel_function<cyclic_rules<NumShades, HasNoTurn>, PowTwoWidth, Layout, CellBits>(kernel);
+  std::snprintf(kernel.name, sizeof(kernel.name), "cyclic%u%s%s%s",
+    NumShades, HasNoTurn ? ",N" : "", PowTwoWidth && !is_tiled<Layout>() ? ",pow2" : "",
+    layout_suffix<Layout, CellBits>());
+}
+
+template <u32 NumShades>
+void set_sentinel_kernel(simulation::step_kernel &kernel)
+{
+  kernel.function = sentinel_kernel_impl<NumShades>;
+  std::snprintf(kernel.name, sizeof(kernel.name), "sentinel%u", NumShades);
+}
+
+template <b8 PowTwoWidth, simulation::grid_layout Layout = simulation::grid_layout::DENSE>
+void set_kernel(
+  simulation::step_kernel &kernel,
+  u32 const bucket,
+  b8 const cyclic,
+  b8 const has_no_turn)
+{
+  // past 16 shades the turn masks spill out of a register and computing
+  // transitions measures slower than looking them up, so use the table
+  if (cyclic && bucket <= 16) {
+    if (has_no_turn) {
+      switch (bucket) {
+        case 2:  set_cyclic_kernel<2,  true, PowTwoWidth, Layout>(kernel); break;
+        case 4:  set_cyclic_kernel<4,  true, PowTwoWidth, Layout>(kernel); break;
+        default: set_cyclic_kernel<16, true, PowTwoWidth, Layout>(kernel); break;
+      }
+    } else {
+      switch (bucket) {
+        case 2:  set_cyclic_kernel<2,  false, PowTwoWidth, Layout>(kernel); break;
+        case 4:  set_cyclic_kernel<4,  false, PowTwoWidth, Layout>(kernel); break;
+        default: set_cyclic_kernel<16, false, PowTwoWidth, Layout>(kernel); break;
+      }
+    }
+  } else {
+    switch (bucket) {
+      case 2:  set_table_kernel<2,   PowTwoWidth, Layout>(kernel); break;
+      case 4:  set_table_kernel<4,   PowTwoWidth, Layout>(kernel); break;
+      case 16: set_table_kernel<16,  PowTwoWidth, Layout>(kernel); break;
+      default: set_table_kernel<256, PowTwoWidth, Layout>(kernel); break;
+    }
+  }
+}
+
+// Torus kernels only come row by row with a power of 2 width, so they're only
+// picked by the ruleset, the same way `set_kernel` does.
+static
+void set_torus_kernel(
+  simulation::step_kernel &kernel,
+  u32 const bucket,
+  b8 const cyclic,
+  b8 const has_no_turn)
+{
+  if (cyclic && bucket <= 16) {
+    if (has_no_turn) {
+      switch (bucket) {
+        case 2:  kernel.function = torus_kernel_impl<cyclic_rules<2,  true>>; break;
+        case 4:  kernel.function = torus_kernel_impl<cyclic_rules<4,  true>>; break;
+        default: kernel.function = torus_kernel_impl<cyclic_rules<16, true>>; break;
+      }
+    } else {
+      switch (bucket) {
+        case 2:  kernel.function = torus_kernel_impl<cyclic_rules<2,  false>>; break;
+        case 4:  kernel.function = torus_kernel_impl<cyclic_rules<4,  false>>; break;
+        default: kernel.function = torus_kernel_impl<cyclic_rules<16, false>>; break;
+      }
+    }
+    std::snprintf(kernel.name, sizeof(kernel.name), "torus,cyclic%u%s", bucket, has_no_turn ? ",N" : "");
+  } else {
+    switch (bucket) {
+      case 2:  kernel.function = torus_kernel_impl<table_rules<2>>; break;
+      case 4:  kernel.function = torus_kernel_impl<table_rules<4>>; break;
+      case 16: kernel.function = torus_kernel_impl<table_rules<16>>; break;
+      default: kernel.function = torus_kernel_impl<table_rules<256>>; break;
+    }
+    std::snprintf(kernel.name, sizeof(kernel.name), "torus,table%u", bucket);
+  }
+}
+
+// A PACKED grid can't hold more than 2^CellBits shades, so that's the bucket.
+template <u32 CellBits, b8 PowTwoWidth>
+void set_packed_kernel(
+  simulation::step_kernel &kernel,
+  b8 const cyclic,
+  b8 const has_no_turn)
+{
+  u32 const num_shades = 1 << CellBits;
+
+  if (cyclic && has_no_turn)
+    set_cyclic_kernel<num_shades, true, PowTwoWidth, simulation::grid_layout::PACKED, CellBits>(kernel);
+  else if (cyclic)
+    set_cyclic_kernel<num_shades, false, PowTwoWidth, simulation::grid_layout::PACKED, CellBits>(kernel);
+  else
+    set_table_kernel<num_shades, PowTwoWidth, simulation::grid_layout::PACKED, CellBits>(kernel);
+}
+
+template <b8 PowTwoWidth>
+void set_packed_kernel(
+  simulation::step_kernel &kernel,
+  u32 const bits_per_cell,
+  b8 const cyclic,
+  b8 const has_no_turn)
+{
+  switch (bits_per_cell) {
+    case 1:  set_packed_kernel<1, PowTwoWidth>(kernel, cyclic, has_no_turn); break;
+    case 2:  set_packed_kernel<2, PowTwoWidth>(kernel, cyclic, has_no_turn); break;
+    default: set_packed_kernel<4, PowTwoWidth>(kernel, cyclic, has_no_turn); break;
+  }
+}
+
+simulation::step_kernel simulation::select_step_kernel(simulation::state const &state)
+{
+  step_kernel kernel{};
+
+  // tiled kernels step within a tile, where rows are a tile apart
+  b8 const tiled = state.layout == grid_layout::TILED || state.layout == grid_layout::SPARSE;
+  kernel.row_stride = tiled ? i32(GRID_TILE_DIM) : state.grid_stride();
+  kernel.transitions = compile_rules(state.rules, kernel.row_stride, state.shade_remap);
+
+  u32 num_rules = 0;
+  b8 has_no_turn = false;
+  for (u32 shade = 0; shade < 256; ++shade) {
+    auto const &rule = state.rules[shade];
+    if (rule.turn_dir == turn_direction::NIL)
+      continue;
+
+    ++num_rules;
+    if (shade < 64 && rule.turn_dir == turn_direction::RIGHT)
+      kernel.right_turn_mask |= u64(1) << shade;
+    else if (shade < 64 && rule.turn_dir == turn_direction::NO_CHANGE)
+      kernel.no_turn_mask |= u64(1) << shade;
+    has_no_turn = has_no_turn || rule.turn_dir == turn_direction::NO_CHANGE;
+  }
+  kernel.num_rules = num_rules;
+
+  // cyclic kernels work out replacements from the shade itself, which no
+  // longer works once shades are remapped
+  b8 cyclic = state.shade_remap == 0;
+  for (u32 shade = 0; cyclic && shade < num_rules; ++shade) {
+    auto const &rule = state.rules[shade];
+    if (rule.turn_dir == turn_direction::NIL || rule.replacement_shade != (shade + 1) % num_rules) {
+      cyclic = false;
+      break;
+    }
+  }
+
+  // every shade in the grid has a governing rule (checked by parse_state),
+  // so the highest ruled shade bounds every shade a kernel will encounter.
+  // Remapped shades can go above it, but not past the next power of 2, which
+  // is as far as any bucket goes
+  u32 const num_shades = u32(deduce_maxval_from_rules(state.rules)) + 1;
+
+  if (state.layout == grid_layout::BORDERED) {
+    u8 const sentinel = state.sentinel_shade;
+    kernel.sentinel_shade = sentinel;
+
+    // stuck in place, facing the same way
+    for (u8 orient_idx = 0; orient_idx < 4; ++orient_idx)
+      kernel.transitions[(u32(sentinel) << 2) | orient_idx] = { 0, 0, 0, sentinel, orient_idx };
+
+    switch (shade_bucket(std::max(num_shades, u32(sentinel) + 1))) {
+      case 2:  set_sentinel_kernel<2>(kernel); break;
+      case 4:  set_sentinel_kernel<4>(kernel); break;
+      case 16: set_sentinel_kernel<16>(kernel); break;
+      default: set_sentinel_kernel<256>(kernel); break;
+    }
+
+    return kernel;
+  }
+
+  u32 const bucket = shade_bucket(cyclic ? num_rules : num_shades);
+
+  b8 const pow_two_width = std::has_single_bit(u32(state.grid_width));
+  kernel.width_shift = u32(std::countr_zero(u32(state.grid_width)));
+
+  if (state.boundary == grid_boundary::TORUS) {
+    set_torus_kernel(kernel, bucket, cyclic, has_no_turn);
+  } else if (state.layout == grid_layout::TILED) {
+    set_kernel<false, grid_layout::TILED>(kernel, bucket, cyclic, has_no_turn);
+  } else if (state.layout == grid_layout::SPARSE) {
+    set_kernel<false, grid_layout::SPARSE>(kernel, bucket, cyclic, has_no_turn);
+  } else if (state.layout == grid_layout::PACKED) {
+    if (pow_two_width)
+      set_packed_kernel<true>(kernel, state.bits_per_cell, cyclic, has_no_turn);
+    else
+      set_packed_kernel<false>(kernel, state.bits_per_cell, cyclic, has_no_turn);
+  } else if (pow_two_width) {
+    set_kernel<true>(kernel, bucket, cyclic, has_no_turn);
+  } else {
+    set_kernel<false>(kernel, bucket, cyclic, has_no_turn);
+  }
+
+  return kernel;
+}
+
+// Steps through a copy of the cells around the ant with `kernel.window_function`,
+// a kernel for a DENSE grid the size of the window, which stops at the edge of
+// the window exactly like it would at the edge of a grid: the cell replaced and
+// the ant turned, but not moved. If that isn't also the edge of the grid, the
+// window is written back and re-centered on the ant's next cell.
+static
+u64 window_kernel_impl(
+  simulation::state &state,
+  simulation::step_kernel const &kernel,
+  u64 const max_steps)
+{
+  using namespace simulation;
+
+  i8 const col_deltas[4] { 0, 1, 0, -1 };
+  i8 const row_deltas[4] { -1, 0, 1, 0 };
+
+  u32 const width = u32(state.grid_width);
+  u32 const height = u32(state.grid_height);
+  u32 const window_width = std::min(WINDOW_DIM, width);
+  u32 const window_height = std::min(WINDOW_DIM, height);
+
+  alignas(64) std::array<u8, WINDOW_DIM * WINDOW_DIM> cells;
+
+  // only what window_function looks at
+  simulation::state window{};
+  window.grid = cells.data();
+  window.grid_width = i32(window_width);
+  window.grid_height = i32(window_height);
+  window.layout = grid_layout::DENSE;
+  window.bits_per_cell = 8;
+
+  u32 col = u32(state.ant_col);
+  u32 row = u32(state.ant_row);
+  orientation::value_type orient = state.ant_orientation;
+
+  u64 steps_taken = 0;
+  b8 hit_edge = false;
+
+  while (steps_taken < max_steps) {
+    // around the ant, as far as the grid allows, with 3/4 of the window ahead
+    // of it, which is usually the way it keeps going
+    u32 const orient_idx = u32(orient - orientation::NORTH);
+    u32 const behind_col = orient_idx == 1 ? WINDOW_DIM / 4 : orient_idx == 3 ? (3 * WINDOW_DIM) / 4 : WINDOW_DIM / 2;
+    u32 const behind_row = orient_idx == 2 ? WINDOW_DIM / 4 : orient_idx == 0 ? (3 * WINDOW_DIM) / 4 : WINDOW_DIM / 2;
+    u32 const window_col = std::min(col - std::min(col, behind_col), width - window_width);
+    u32 const window_row = std::min(row - std::min(row, behind_row), height - window_height);
+
+    load_cells(state, window_col, window_row, window_width, window_height, cells.data(), window_width);
+
+    window.ant_col = i32(col - window_col);
+    window.ant_row = i32(row - window_row);
+    window.ant_orientation = orient;
+    window.generation = 0;
+
+    u64 const burst = max_steps - steps_taken;
+    u64 const completed = kernel.window_function(window, kernel, burst);
+
+    store_cells(state, window_col, window_row, window_width, window_height, cells.data(), window_width);
+
+    col = window_col + u32(window.ant_col);
+    row = window_row + u32(window.ant_row);
+    orient = window.ant_orientation;
+    steps_taken += completed;
+
+    if (completed == burst)
+      break;
+
+    // stepping out of the window already replaced its cell and turned the ant,
+    // all that's left is moving, if there's any grid left to move onto
+    u32 const exit_orient_idx = u32(orient - orientation::NORTH);
+    u32 const next_col = col + u32(i32(col_deltas[exit_orient_idx]));
+    u32 const next_row = row + u32(i32(row_deltas[exit_orient_idx]));
+
+    if (next_col >= width || next_row >= height) {
+      hit_edge = true;
+      break;
+    }
+
+    col = next_col;
+    row = next_row;
+    ++steps_taken;
+  }
+
+  state.ant_col = i32(col);
+  state.ant_row = i32(row);
+  state.ant_orientation = orient;
+  state.generation += steps_taken;
+
+  if (hit_edge)
+    state.last_step_res = step_result::HIT_EDGE;
+  else if (steps_taken > 0)
+    state.last_step_res = step_result::SUCCESS;
+
+  return steps_taken;
+}
+
+simulation::step_kernel simulation::select_window_kernel(simulation::state const &state)
+{
+  // holds cells as stored, so shades are remapped just the same
+  simulation::state window{};
+  window.grid_width = i32(std::min(WINDOW_DIM, u32(state.grid_width)));
+  window.grid_height = i32(std::min(WINDOW_DIM, u32(state.grid_height)));
+  window.layout = grid_layout::DENSE;
+  window.bits_per_cell = 8;
+  window.shade_remap = state.shade_remap;
+  window.rules = state.rules;
+
+  step_kernel kernel = select_step_kernel(window);
+  kernel.window_function = kernel.function;
+  kernel.function = window_kernel_impl;
+
+  char inner_name[sizeof(kernel.name)];
+  std::memcpy(inner_name, kernel.name, sizeof(inner_name));
+  std::snprintf(kernel.name, sizeof(kernel.name), "window,%.24s", inner_name);
+
+  return kernel;
+}
+
+u64 simulation::step_forward(
+  simulation::state &state,
+  step_kernel const &kernel,
+  u64 const max_steps)
+{
+  return kernel.function(state, kernel, max_steps);
+}
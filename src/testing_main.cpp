@@ -83,6 +83,7 @@ i32 main()
         ntest::assert_int32(expected_state.ant_row, actual_state.ant_row, loc);
         ntest::assert_int8(expected_state.ant_orientation, actual_state.ant_orientation, loc);
         ntest::assert_stdarr(expected_state.rules, actual_state.rules, loc);
+        ntest::assert_uint8(u8(expected_state.boundary), u8(actual_state.boundary), loc);
         ntest::assert_arr(
           expected_state.grid,
           expected_state.grid == nullptr ? 0 : actual_state.num_pixels(),
@@ -145,10 +146,10 @@ i32 main()
 
     assert_parse({/* state */}, {
       // errors:
-      "bad grid_width, cannot be > 65535",
-      "bad grid_height, cannot be > 65535",
-      "bad ant_col, cannot be > 65535",
-      "bad ant_row, cannot be > 65535",
+      "bad grid_width, cannot be > 1048576",
+      "bad grid_height, cannot be > 1048576",
+      "bad ant_col, cannot be > 1048576",
+      "bad ant_row, cannot be > 1048576",
       "bad last_step_result, not one of nil|success|hit_edge",
       "bad ant_orientation, not one of N|E|S|W",
       "bad rules, [0].on is > 255",
@@ -165,8 +166,8 @@ i32 main()
 
     assert_parse({/* state */}, {
       // errors:
-      "bad grid_width, must be in range [1, 65535]",
-      "bad grid_height, must be in range [1, 65535]",
+      "bad grid_width, must be in range [1, 1048576]",
+      "bad grid_height, must be in range [1, 1048576]",
       "bad rules, [0].replace_with is > 255",
       "bad grid_state, file \"non_existent_file\" does not exist",
     }, "value_errors_3.json");
@@ -202,6 +203,21 @@ i32 main()
       "bad rules, don't form a closed chain"
     }, "value_errors_9.json");
 
+    assert_parse({/* state */}, {
+      // errors:
+      "bad grid_state, shade 0 in file \"good_img.pgm\" has no governing rule",
+    }, "value_errors_10.json");
+
+    assert_parse({/* state */}, {
+      // errors:
+      "bad boundary, not one of edge|torus",
+    }, "value_errors_11.json");
+
+    assert_parse({/* state */}, {
+      // errors:
+      "bad boundary, torus grid_width and grid_height must be powers of 2",
+    }, "value_errors_12.json");
+
     {
       u8 grid[5 * 6];
       std::fill_n(grid, 5 * 6, u8(0));
@@ -222,6 +238,26 @@ i32 main()
       assert_parse(expected_state, {/* no errors */}, "good_fill.json");
     }
 
+    {
+      u8 grid[8 * 4];
+      std::fill_n(grid, 8 * 4, u8(0));
+
+      simulation::state expected_state{};
+      expected_state.grid_width = 8;
+      expected_state.grid_height = 4;
+      expected_state.ant_col = 2;
+      expected_state.ant_row = 3;
+      expected_state.grid = grid;
+      expected_state.ant_orientation = simulation::orientation::WEST;
+      expected_state.boundary = simulation::grid_boundary::TORUS;
+      expected_state.rules = generate_rules({
+        { 0, { 1, simulation::turn_direction::LEFT } },
+        { 1, { 0, simulation::turn_direction::RIGHT } },
+      }),
+
+      assert_parse(expected_state, {/* no errors */}, "good_torus.json");
+    }
+
     {
       u8 grid[5 * 5] {
         0, 1, 0, 1, 0,
@@ -249,6 +285,71 @@ i32 main()
       }),
 
       assert_parse(expected_state, {/* no errors */}, "good_img.json");
+
+      // through a seed image cache, decoded (plain) or mapped (raw) once with
+      // each grid its own
+      {
+        // a raw copy of good_img.pgm, and a state naming it
+        std::string json_str = util::extract_txt_file_contents("testing/parse/good_img.json", true);
+        json_str.replace(json_str.find("good_img.pgm"), std::strlen("good_img.pgm"), "good_img_raw.actual.pgm");
+        {
+          std::fstream file = util::open_file("testing/run/good_img_raw.actual.json", std::ios::out);
+          file << json_str;
+        }
+        {
+          pgm8::image_properties props;
+          props.set_format(pgm8::format::RAW);
+          props.set_width(5);
+          props.set_height(5);
+          props.set_maxval(2);
+          std::fstream file = util::open_file("testing/run/good_img_raw.actual.pgm", std::ios::out | std::ios::binary);
+          ntest::assert_bool(true, pgm8::write(file, props, grid));
+        }
+
+        for (char const *const dir : { "testing/parse/", "testing/run/" }) {
+          fs::path const state_path = fs::path(dir) / (std::strcmp(dir, "testing/run/") == 0 ? "good_img_raw.actual.json" : "good_img.json");
+          std::string const state_str = util::extract_txt_file_contents(state_path.string(), true);
+          simulation::seed_image_cache seed_images{};
+          errors_t errors{};
+
+          // three states name the image, so it goes once the third is parsed
+          simulation::count_seed_image_references(seed_images, { state_path, state_path, state_path }, dir);
+
+          simulation::state first = simulation::parse_state(state_str, dir, errors,
+            simulation::grid_layout::DENSE, simulation::huge_pages::OFF, &seed_images);
+          simulation::state second = simulation::parse_state(state_str, dir, errors,
+            simulation::grid_layout::DENSE, simulation::huge_pages::OFF, &seed_images);
+          ntest::assert_uint64(1, seed_images.images.size());
+          simulation::state packed = simulation::parse_state(state_str, dir, errors,
+            simulation::grid_layout::PACKED, simulation::huge_pages::OFF, &seed_images);
+          ntest::assert_uint64(0, errors.size());
+          ntest::assert_uint64(0, seed_images.images.size());
+          ntest::assert_uint64(0, seed_images.pending_references.size());
+
+          first.set_cell(0, 2);
+          simulation::release_seed_images(seed_images);
+
+          ntest::assert_uint8(2, first.get_cell(0));
+          b8 second_same = true, packed_same = true;
+          for (u64 i = 0; i < 25; ++i) {
+            second_same = second_same && second.get_cell(i) == grid[i];
+            packed_same = packed_same && packed.get_cell(i) == grid[i];
+          }
+          ntest::assert_bool(true, second_same);
+          ntest::assert_bool(true, packed_same);
+
+          simulation::free_grid(first);
+          simulation::free_grid(second);
+          simulation::free_grid(packed);
+        }
+
+        // the raw file is never written to through the clones
+        std::vector<u8> pixels(25);
+        std::ifstream file("testing/run/good_img_raw.actual.pgm", std::ios::binary);
+        pgm8::image_properties const props = pgm8::read_properties(file);
+        pgm8::read_pixels(file, props, pixels.data());
+        ntest::assert_bool(true, std::equal(pixels.begin(), pixels.end(), grid));
+      }
     }
   }
   #endif // simulation::parse_state
@@ -278,6 +379,135 @@ i32 main()
   }
   #endif // util::parse_json_array_u64
 
+  #if 1 // pgm8 COMPRESSED
+  {
+    // several bands, with long runs and noise in between
+    u32 const width = 3000, height = 1000;
+    std::vector<u8> pixels(u64(width) * height);
+    u32 noise = 1;
+    for (u64 i = 0; i < pixels.size(); ++i) {
+      noise = (noise * 1664525) + 1013904223;
+      pixels[i] = (i / 5000) % 2 == 0 ? u8((i / 3000) % 4) : u8(noise >> 30);
+    }
+
+    pgm8::image_properties props;
+    props.set_format(pgm8::format::COMPRESSED);
+    props.set_width(width);
+    props.set_height(height);
+    props.set_maxval(3);
+
+    std::string const path = "testing/run/pgm8_compressed.actual.pgmz";
+    {
+      std::fstream file = util::open_file(path, std::ios::out | std::ios::binary);
+      ntest::assert_bool(true, pgm8::write(file, props, pixels.data()));
+    }
+    ntest::assert_bool(true, fs::file_size(path) < pixels.size() / 4);
+
+    {
+      std::ifstream file(path, std::ios::binary);
+      pgm8::image_properties const read_props = pgm8::read_properties(file);
+      ntest::assert_uint8(u8(pgm8::format::COMPRESSED), u8(read_props.get_format()));
+      std::vector<u8> read(pixels.size());
+      pgm8::read_pixels(file, read_props, read.data());
+      ntest::assert_bool(true, read == pixels);
+    }
+    {
+      // 2 bits per pixel, lowest bits first
+      std::ifstream file(path, std::ios::binary);
+      pgm8::image_properties const read_props = pgm8::read_properties(file);
+      std::vector<u8> packed(pixels.size() / 4);
+      pgm8::read_pixels(file, read_props, packed.data(), 0, 2);
+      b8 match = true;
+      for (u64 i = 0; i < pixels.size(); ++i)
+        match = match && ((packed[i / 4] >> ((i % 4) * 2)) & 3) == pixels[i];
+      ntest::assert_bool(true, match);
+    }
+    {
+      // a band claiming to be bigger than it could possibly deflate to
+      std::string const corrupt_path = "testing/run/pgm8_compressed_corrupt.actual.pgmz";
+      fs::copy_file(path, corrupt_path, fs::copy_options::overwrite_existing);
+      {
+        std::fstream file(corrupt_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(std::streamoff(pgm8::header(props).size() + sizeof(u32)));
+        u64 const huge_size = u64(1) << 62;
+        file.write(reinterpret_cast<char const *>(&huge_size), sizeof(huge_size));
+      }
+      std::ifstream file(corrupt_path, std::ios::binary);
+      pgm8::image_properties const read_props = pgm8::read_properties(file);
+      std::vector<u8> read(pixels.size());
+      ntest::assert_throws<std::runtime_error>([&] {
+        pgm8::read_pixels(file, read_props, read.data());
+      });
+    }
+    {
+      fs::resize_file(path, fs::file_size(path) - 10);
+      std::ifstream file(path, std::ios::binary);
+      pgm8::image_properties const read_props = pgm8::read_properties(file);
+      ntest::assert_throws<std::runtime_error>([&] {
+        pgm8::read_rows(file, read_props, [](size_t, u8 const *) {});
+      });
+    }
+  }
+  #endif // pgm8 COMPRESSED
+
+  #if 1 // pgm8::map_raw
+  {
+    u32 const width = 5000, height = 3;
+    std::vector<u8> pixels(u64(width) * height);
+    for (u64 i = 0; i < pixels.size(); ++i)
+      pixels[i] = u8(i * 7);
+
+    pgm8::image_properties props;
+    props.set_format(pgm8::format::RAW);
+    props.set_width(width);
+    props.set_height(height);
+    props.set_maxval(255);
+
+    std::string const path = "testing/run/pgm8_mapped.actual.pgm";
+    {
+      std::fstream file = util::open_file(path, std::ios::out | std::ios::binary);
+      ntest::assert_bool(true, pgm8::write(file, props, pixels.data()));
+      // trailing bytes are ignored, as by read_pixels
+      file << "junk";
+    }
+
+    {
+      pgm8::mapped_image image{};
+      ntest::assert_bool(true, pgm8::map_raw(path.c_str(), image, true));
+      ntest::assert_uint32(width, image.props.get_width());
+      ntest::assert_uint32(height, image.props.get_height());
+      ntest::assert_uint64(pgm8::header(props).size(), image.pixel_offset);
+      ntest::assert_bool(true, std::memcmp(image.mapping + image.pixel_offset, pixels.data(), pixels.size()) == 0);
+
+      // copy-on-write, the file stays as it was
+      image.mapping[image.pixel_offset] = 42;
+      pgm8::unmap(image);
+      std::ifstream file(path, std::ios::binary);
+      pgm8::image_properties const read_props = pgm8::read_properties(file);
+      std::vector<u8> read(pixels.size());
+      pgm8::read_pixels(file, read_props, read.data());
+      ntest::assert_bool(true, read == pixels);
+    }
+    {
+      fs::resize_file(path, pgm8::header(props).size() + pixels.size() - 1);
+      pgm8::mapped_image image{};
+      ntest::assert_throws<std::runtime_error>([&] {
+        (void)pgm8::map_raw(path.c_str(), image, false);
+      });
+    }
+    {
+      // other formats are left to streams
+      props.set_format(pgm8::format::PLAIN);
+      {
+        std::fstream file = util::open_file(path, std::ios::out | std::ios::binary);
+        ntest::assert_bool(true, pgm8::write(file, props, pixels.data()));
+      }
+      pgm8::mapped_image image{};
+      ntest::assert_bool(false, pgm8::map_raw(path.c_str(), image, false));
+    }
+  }
+  #endif // pgm8::map_raw
+
   #if 1 // simulation::run
   {
     auto const assert_save_point = [](
@@ -354,6 +584,7 @@ i32 main()
         true, // save_final_state
         false, // create_logs
         false, // save_image_only
+        {}, // engine
         nullptr, // num_simulations_processed
         0 // total_num_of_simulations
       );
@@ -393,6 +624,7 @@ i32 main()
         true, // save_final_state
         false, // create_logs
         false, // save_image_only
+        {}, // engine
         nullptr, // num_simulations_processed
         0 // total_num_of_simulations
       );
@@ -430,6 +662,7 @@ i32 main()
         true, // save_final_state
         false, // create_logs
         false, // save_image_only
+        {}, // engine
         nullptr, // num_simulations_processed
         0 // total_num_of_simulations
       );
@@ -441,6 +674,26 @@ i32 main()
       assert_save_point("RL_raw.expect(50).json", "RL_raw.expect(50).pgm", "RL_raw.actual(50).json");
     }
 
+    // saving over the image a grid was mapped from, which has to stay intact
+    {
+      fs::copy_file(save_dir / "RL_raw.expect(16).pgm", save_dir / "RL_resave.actual(16).pgm",
+        fs::copy_options::overwrite_existing);
+      std::string json_str = util::extract_txt_file_contents("testing/run/RL_raw.expect(16).json", false);
+      json_str.replace(json_str.find("RL_raw.expect(16).pgm"), std::strlen("RL_raw.expect(16).pgm"), "RL_resave.actual(16).pgm");
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors);
+      assert(errors.empty());
+      state.maxval = simulation::deduce_maxval_from_rules(state.rules);
+
+      auto const result = simulation::save_state(state, "RL_resave.actual", save_dir, pgm8::format::RAW, true);
+      ntest::assert_bool(true, result.image_write_success);
+      ntest::assert_bool(true,
+        util::extract_txt_file_contents("testing/run/RL_resave.actual(16).pgm", true)
+        == util::extract_txt_file_contents("testing/run/RL_raw.expect(16).pgm", true));
+      ntest::assert_bool(false, fs::exists(save_dir / "RL_resave.actual(16).pgm.tmp"));
+
+      simulation::free_grid(state);
+    }
+
     // starting from generation 16, raw image
     {
       std::string const json_str = util::extract_txt_file_contents("testing/run/RL_raw.expect(16).json", false);
@@ -469,6 +722,7 @@ i32 main()
         true, // save_final_state
         false, // create_logs
         false, // save_image_only
+        {}, // engine
         nullptr, // num_simulations_processed
         0 // total_num_of_simulations
       );
@@ -477,9 +731,1035 @@ i32 main()
       assert_save_point("RL_raw.expect(48).json", "RL_raw.expect(48).pgm", "RL_raw_from16.actual(48).json");
       assert_save_point("RL_raw.expect(50).json", "RL_raw.expect(50).pgm", "RL_raw_from16.actual(50).json");
     }
+
+    // starting from generation 16, bordered, packed, tiled and sparse grids, both image formats
+    for (auto const layout : { simulation::grid_layout::BORDERED, simulation::grid_layout::PACKED, simulation::grid_layout::TILED, simulation::grid_layout::SPARSE })
+    for (auto const img_fmt : { pgm8::format::PLAIN, pgm8::format::RAW }) {
+      b8 const plain = img_fmt == pgm8::format::PLAIN;
+      std::string const fmt_name = plain ? "plain" : "raw";
+      std::string const layout_name =
+        layout == simulation::grid_layout::BORDERED ? "bordered" :
+        layout == simulation::grid_layout::PACKED ? "packed" :
+        layout == simulation::grid_layout::TILED ? "tiled" : "sparse";
+      std::string const name = "RL_" + fmt_name + "_" + layout_name + ".actual";
+
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL_" + fmt_name + ".expect(16).json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors, layout);
+      assert(errors.empty());
+
+      {
+        auto const to_delete = fregex::find(
+          save_dir.string().c_str(),
+          ("RL_" + fmt_name + "_" + layout_name + "\\.actual.*").c_str(),
+          fregex::entry_type::regular_file);
+
+        for (auto const &file : to_delete) {
+          fs::remove_all(file);
+        }
+      }
+
+      simulation::run(
+        state,
+        name,
+        50, // generation_limit
+        { 3, 50 }, // save_points
+        16, // save_interval
+        img_fmt,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        {}, // engine
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+
+      simulation::free_grid(state);
+
+      // saves must be byte-identical to those made from a dense grid
+      for (char const *const gen : { "32", "48", "50" }) {
+        std::string const expect = "RL_" + fmt_name + ".expect(" + gen + ")";
+        std::string const actual = name + "(" + gen + ").json";
+        assert_save_point((expect + ".json").c_str(), (expect + ".pgm").c_str(), actual.c_str());
+      }
+    }
+
+    // saves written on save threads, with room for every copy, for one copy at a
+    // time and for none at all (so they're made on the simulating thread)
+    for (u64 const buffer_bytes : { u64(1024) * 1024, u64(7 * 8), u64(1) })
+    for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::PACKED, simulation::grid_layout::SPARSE }) {
+      std::string const name = "RL_raw_async_" + std::to_string(buffer_bytes) + "_" + std::to_string(u32(layout)) + ".actual";
+
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL_raw.expect(16).json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors, layout);
+      assert(errors.empty());
+
+      simulation::start_save_threads(2, buffer_bytes);
+
+      auto const result = simulation::run(
+        state,
+        name,
+        50, // generation_limit
+        { 3, 50 }, // save_points
+        16, // save_interval
+        pgm8::format::RAW,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        {}, // engine
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+
+      // run only returns once its saves are written
+      ntest::assert_uint64(3, result.num_save_points_successful);
+      ntest::assert_uint64(0, result.num_save_points_failed);
+
+      simulation::stop_save_threads();
+      simulation::free_grid(state);
+
+      for (char const *const gen : { "32", "48", "50" }) {
+        std::string const expect = std::string("RL_raw.expect(") + gen + ")";
+        std::string const actual = name + "(" + gen + ").json";
+        assert_save_point((expect + ".json").c_str(), (expect + ".pgm").c_str(), actual.c_str());
+      }
+    }
+
+    // grids kept in a file, both handed over and (for a packed grid which
+    // can't be) saved as usual
+    for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::PACKED }) {
+      std::string const name = layout == simulation::grid_layout::DENSE ? "RL_raw_live_dense.actual" : "RL_raw_live_packed.actual";
+
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL_raw.expect(16).json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors, layout);
+      assert(errors.empty());
+
+      simulation::engine_options engine{};
+      engine.live_grid_file = true;
+
+      simulation::run(
+        state,
+        name,
+        50, // generation_limit
+        { 3, 48 }, // save_points
+        16, // save_interval
+        pgm8::format::RAW,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        engine,
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+
+      // the final save has the file now
+      ntest::assert_bool(layout == simulation::grid_layout::DENSE, state.file != nullptr);
+      ntest::assert_bool(false, fs::exists(save_dir / (name + ".live.pgm")));
+      simulation::free_grid(state);
+
+      for (char const *const gen : { "32", "48", "50" }) {
+        std::string const expect = std::string("RL_raw.expect(") + gen + ")";
+        std::string const actual = name + "(" + gen + ").json";
+        assert_save_point((expect + ".json").c_str(), (expect + ".pgm").c_str(), actual.c_str());
+      }
+    }
+
+    // deltas between full images every third save, materialized newest first so
+    // the whole chain back to the full image is applied
+    for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::SPARSE }) {
+      std::string const name = layout == simulation::grid_layout::DENSE ? "RL_plain_delta_dense.actual" : "RL_plain_delta_sparse.actual";
+
+      for (auto const &file : fregex::find(save_dir.string().c_str(), "RL_plain_delta_.*", fregex::entry_type::regular_file))
+        fs::remove_all(file);
+
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL-init.json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors, layout);
+      assert(errors.empty());
+
+      simulation::engine_options engine{};
+      engine.keyframe_interval = 3;
+
+      simulation::run(
+        state,
+        name,
+        50, // generation_limit
+        { 3, 50 }, // save_points
+        16, // save_interval
+        pgm8::format::PLAIN,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        engine,
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+      simulation::free_grid(state);
+
+      // 3 and 48 are full images, as is the final save
+      for (char const *const gen : { "3", "48", "50" })
+        ntest::assert_bool(true, fs::exists(save_dir / (name + "(" + gen + ").pgm")));
+      for (char const *const gen : { "16", "32" }) {
+        ntest::assert_bool(false, fs::exists(save_dir / (name + "(" + gen + ").pgm")));
+        ntest::assert_bool(true, fs::exists(save_dir / (name + "(" + gen + ").delta")));
+      }
+
+      simulation::materialize_delta(save_dir / (name + "(32).delta"), pgm8::format::NIL);
+      simulation::materialize_delta(save_dir / (name + "(16).delta"), pgm8::format::NIL);
+
+      for (char const *const gen : { "3", "16", "32", "48", "50" }) {
+        std::string const expect = std::string("RL_plain.expect(") + gen + ")";
+        std::string const actual = name + "(" + gen + ").json";
+        assert_save_point((expect + ".json").c_str(), (expect + ".pgm").c_str(), actual.c_str());
+      }
+    }
+
+    // checkpoints, resumed from with the grid mapped (DENSE) and copied
+    {
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL-init.json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors);
+      assert(errors.empty());
+
+      simulation::engine_options engine{};
+      engine.checkpoint_saves = true;
+
+      auto const result = simulation::run(
+        state,
+        "RL_ckpt.actual",
+        50, // generation_limit
+        { 3, 50 }, // save_points
+        16, // save_interval
+        pgm8::format::PLAIN,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        engine,
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+      simulation::free_grid(state);
+
+      ntest::assert_uint64(5, result.num_save_points_successful);
+      ntest::assert_bool(false, fs::exists(save_dir / "RL_ckpt.actual(16).json"));
+    }
+    for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::PACKED, simulation::grid_layout::SPARSE }) {
+      std::string const name = "RL_plain_from_ckpt_" + std::to_string(u32(layout)) + ".actual";
+
+      simulation::state state = simulation::load_checkpoint(save_dir / "RL_ckpt.actual(16).ckpt", errors, layout);
+      assert(errors.empty());
+      ntest::assert_uint64(16, state.generation);
+      ntest::assert_uint8(u8(layout), u8(state.layout));
+
+      simulation::run(
+        state,
+        name,
+        50, // generation_limit
+        {}, // save_points
+        16, // save_interval
+        pgm8::format::PLAIN,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        {}, // engine
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+      simulation::free_grid(state);
+
+      for (char const *const gen : { "32", "48", "50" }) {
+        std::string const expect = std::string("RL_plain.expect(") + gen + ")";
+        std::string const actual = name + "(" + gen + ").json";
+        assert_save_point((expect + ".json").c_str(), (expect + ".pgm").c_str(), actual.c_str());
+      }
+    }
+    {
+      errors_t load_errors{};
+      simulation::load_checkpoint(save_dir / "RL-init.json", load_errors);
+      ntest::assert_stdvec({ "\"testing/run/RL-init.json\" is not a checkpoint" }, load_errors);
+    }
+    {
+      // saving over the checkpoint a grid was mapped from, which has to stay intact
+      fs::path const path = save_dir / "RL_ckpt_resave.actual(16).ckpt";
+      fs::copy_file(save_dir / "RL_ckpt.actual(16).ckpt", path, fs::copy_options::overwrite_existing);
+      simulation::state state = simulation::load_checkpoint(path, errors);
+      assert(errors.empty());
+      ntest::assert_bool(true, simulation::save_checkpoint(state, "RL_ckpt_resave.actual", save_dir));
+      ntest::assert_bool(true,
+        util::extract_txt_file_contents(path.string(), true)
+        == util::extract_txt_file_contents((save_dir / "RL_ckpt.actual(16).ckpt").string(), true));
+      simulation::free_grid(state);
+    }
+    {
+      // a torus has to be as parse_state would have it, the RL grid is 7x8
+      fs::path const path = save_dir / "RL_ckpt_torus.actual(16).ckpt";
+      fs::copy_file(save_dir / "RL_ckpt.actual(16).ckpt", path, fs::copy_options::overwrite_existing);
+      {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(66); // boundary
+        file.put(char(simulation::grid_boundary::TORUS));
+      }
+      errors_t load_errors{};
+      simulation::load_checkpoint(path, load_errors);
+      ntest::assert_stdvec({
+        "failed to load \"testing/run/RL_ckpt_torus.actual(16).ckpt\" - bad boundary, torus grid_width and grid_height must be powers of 2"
+      }, load_errors);
+    }
+    {
+      // shades without a rule, listed in the header or only in the cells
+      std::string const expected_error = "failed to load \"testing/run/RL_ckpt_bad.actual(16).ckpt\" - shade 200 in the grid has no governing rule";
+      fs::path const path = save_dir / "RL_ckpt_bad.actual(16).ckpt";
+      for (u64 const offset : { u64(584 + (200 / 8)), simulation::CHECKPOINT_GRID_OFFSET }) {
+        fs::copy_file(save_dir / "RL_ckpt.actual(16).ckpt", path, fs::copy_options::overwrite_existing);
+        {
+          std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+          file.seekp(std::streamoff(offset));
+          file.put(char(offset == simulation::CHECKPOINT_GRID_OFFSET ? 200 : 1 << (200 % 8)));
+        }
+        for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::PACKED }) {
+          if (offset == simulation::CHECKPOINT_GRID_OFFSET && layout == simulation::grid_layout::DENSE)
+            continue; // mapped, so only the header is checked
+          errors_t load_errors{};
+          simulation::load_checkpoint(path, load_errors, layout);
+          ntest::assert_stdvec({ expected_error }, load_errors);
+        }
+      }
+    }
+
+    // compressed saves, read back as grid_state by each layout
+    {
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL-init.json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors);
+      assert(errors.empty());
+
+      simulation::run(
+        state,
+        "RL_compressed.actual",
+        16, // generation_limit
+        {}, // save_points
+        0, // save_interval
+        pgm8::format::COMPRESSED,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        {}, // engine
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+      simulation::free_grid(state);
+
+      ntest::assert_bool(true, fs::exists(save_dir / "RL_compressed.actual(16).pgmz"));
+    }
+    for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::PACKED, simulation::grid_layout::SPARSE }) {
+      std::string const name = "RL_plain_from_compressed_" + std::to_string(u32(layout)) + ".actual";
+
+      std::string const json_str = util::extract_txt_file_contents("testing/run/RL_compressed.actual(16).json", false);
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors, layout);
+      assert(errors.empty());
+
+      simulation::run(
+        state,
+        name,
+        50, // generation_limit
+        {}, // save_points
+        16, // save_interval
+        pgm8::format::PLAIN,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        {}, // engine
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+      simulation::free_grid(state);
+
+      for (char const *const gen : { "32", "48", "50" }) {
+        std::string const expect = std::string("RL_plain.expect(") + gen + ")";
+        std::string const actual = name + "(" + gen + ").json";
+        assert_save_point((expect + ".json").c_str(), (expect + ".pgm").c_str(), actual.c_str());
+      }
+    }
+
+    // sparse grid from a fill, saved with most of its chunks never written to
+    for (auto const img_fmt : { pgm8::format::PLAIN, pgm8::format::RAW }) {
+      std::string const fmt_name = img_fmt == pgm8::format::PLAIN ? "plain" : "raw";
+
+      std::string const json_str =
+        "{ \"generation\": 0, \"last_step_result\": \"nil\", \"grid_width\": 150, \"grid_height\": 100,"
+        "  \"grid_state\": \"fill=1\", \"ant_col\": 100, \"ant_row\": 30, \"ant_orientation\": \"W\","
+        "  \"rules\": [ { \"on\": 0, \"replace_with\": 1, \"turn\": \"R\" }, { \"on\": 1, \"replace_with\": 0, \"turn\": \"L\" } ] }";
+
+      for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::SPARSE }) {
+        std::string const name = "fill_" + fmt_name + (layout == simulation::grid_layout::DENSE ? "_dense" : "_sparse") + ".actual";
+
+        simulation::state state = simulation::parse_state(json_str, save_dir, errors, layout);
+        assert(errors.empty());
+
+        simulation::run(
+          state,
+          name,
+          3000, // generation_limit
+          {}, // save_points
+          1000, // save_interval
+          img_fmt,
+          save_dir,
+          true, // save_final_state
+          false, // create_logs
+          false, // save_image_only
+          {}, // engine
+          nullptr, // num_simulations_processed
+          0 // total_num_of_simulations
+        );
+
+        simulation::free_grid(state);
+      }
+
+      for (char const *const gen : { "1000", "2000", "3000" }) {
+        std::string const dense = "fill_" + fmt_name + "_dense.actual(" + gen + ")";
+        std::string const sparse = "fill_" + fmt_name + "_sparse.actual(" + gen + ").json";
+        assert_save_point((dense + ".json").c_str(), (dense + ".pgm").c_str(), sparse.c_str());
+      }
+    }
+
+    // wider than 65535 cells, saved and loaded back row by row
+    for (auto const img_fmt : { pgm8::format::PLAIN, pgm8::format::RAW }) {
+      std::string const name = img_fmt == pgm8::format::PLAIN ? "wide_plain.actual" : "wide_raw.actual";
+
+      std::string const json_str =
+        "{ \"generation\": 0, \"last_step_result\": \"nil\", \"grid_width\": 100000, \"grid_height\": 70,"
+        "  \"grid_state\": \"fill=0\", \"ant_col\": 99990, \"ant_row\": 35, \"ant_orientation\": \"N\","
+        "  \"rules\": [ { \"on\": 0, \"replace_with\": 1, \"turn\": \"R\" }, { \"on\": 1, \"replace_with\": 0, \"turn\": \"L\" } ] }";
+
+      simulation::state state = simulation::parse_state(json_str, save_dir, errors, simulation::grid_layout::SPARSE);
+      assert(errors.empty());
+
+      simulation::run(
+        state,
+        name,
+        5000, // generation_limit
+        {}, // save_points
+        0, // save_interval
+        img_fmt,
+        save_dir,
+        true, // save_final_state
+        false, // create_logs
+        false, // save_image_only
+        {}, // engine
+        nullptr, // num_simulations_processed
+        0 // total_num_of_simulations
+      );
+
+      std::string const saved_json = util::extract_txt_file_contents(
+        (save_dir / (name + "(" + std::to_string(state.generation) + ").json")).string(), false);
+
+      for (auto const layout : { simulation::grid_layout::DENSE, simulation::grid_layout::SPARSE }) {
+        simulation::state loaded = simulation::parse_state(saved_json, save_dir, errors, layout);
+        ntest::assert_uint64(0, errors.size());
+        ntest::assert_int32(100000, loaded.grid_width);
+        ntest::assert_uint64(state.generation, loaded.generation);
+
+        b8 same = true;
+        for (u64 idx = 0; idx < state.num_pixels() && same; ++idx)
+          same = loaded.get_cell(((idx / 100000) * u64(loaded.grid_stride())) + (idx % 100000)) == state.get_cell(idx);
+        ntest::assert_bool(true, same);
+
+        // the image's background stays uncommitted
+        if (layout == simulation::grid_layout::SPARSE)
+          ntest::assert_bool(true, loaded.sparse->committed.size() <= state.sparse->committed.size());
+
+        simulation::free_grid(loaded);
+      }
+
+      simulation::free_grid(state);
+    }
   }
   #endif // simulation::run
 
+  #if 1 // simulation::step_forward
+  {
+    // copies the cells of `state.grid` without any border, one shade per byte
+    auto const grid_cells = [](simulation::state const &state)
+    {
+      std::vector<u8> cells{};
+      cells.reserve(state.num_pixels());
+      for (i32 row = 0; row < state.grid_height; ++row)
+        for (i32 col = 0; col < state.grid_width; ++col)
+          cells.push_back(state.get_cell(u64((i64(row) * state.grid_stride()) + col)));
+      return cells;
+    };
+
+    // runs `reference` one generation at a time with attempt_step_forward and `actual`
+    // with step_forward (or step_forward_memoized if `memo` isn't null) in chunks
+    // of `chunk_size`, with a window kernel if `windowed`, then compares the two
+    auto const assert_step_forward_equivalent = [&grid_cells](
+      simulation::state reference,
+      simulation::state actual,
+      u64 const num_gens,
+      u64 const chunk_size,
+      simulation::memo_table *const memo,
+      simulation::highway_tracker *const highways,
+      b8 const windowed = false,
+      std::source_location const loc = std::source_location::current())
+    {
+      for (u64 i = 0; i < num_gens; ++i) {
+        reference.last_step_res = simulation::attempt_step_forward(reference);
+        if (reference.last_step_res != simulation::step_result::SUCCESS)
+          break;
+        ++reference.generation;
+      }
+
+      auto const kernel = windowed
+        ? simulation::select_window_kernel(actual)
+        : simulation::select_step_kernel(actual);
+      for (u64 remaining = num_gens; remaining > 0;) {
+        u64 const chunk = std::min(remaining, chunk_size);
+        u64 const completed = highways != nullptr
+          ? simulation::step_forward_fast_forwarding_highways(actual, kernel, memo, *highways, chunk)
+          : memo != nullptr
+          ? simulation::step_forward_memoized(actual, kernel, *memo, chunk)
+          : simulation::step_forward(actual, kernel, chunk);
+        if (completed < chunk)
+          break;
+        remaining -= completed;
+      }
+
+      ntest::assert_uint64(reference.generation, actual.generation, loc);
+      ntest::assert_int8(reference.last_step_res, actual.last_step_res, loc);
+      ntest::assert_int32(reference.ant_col, actual.ant_col, loc);
+      ntest::assert_int32(reference.ant_row, actual.ant_row, loc);
+      ntest::assert_int8(reference.ant_orientation, actual.ant_orientation, loc);
+      ntest::assert_stdvec(grid_cells(reference), grid_cells(actual), loc);
+    };
+
+    // makes a state with a random grid governed by a random ruleset, which is the canonical
+    // cyclic chain 0->1->...->0 if `cyclic`, otherwise a chain of randomly picked shades.
+    // The grid must be released with simulation::free_grid.
+    auto const make_random_state = [](
+      i32 const grid_width,
+      i32 const grid_height,
+      u32 const num_rules,
+      b8 const cyclic,
+      u32 const seed,
+      simulation::grid_layout const layout)
+    {
+      std::srand(seed);
+
+      simulation::state state{};
+      state.grid_width = grid_width;
+      state.grid_height = grid_height;
+      state.ant_col = grid_width / 2;
+      state.ant_row = grid_height / 2;
+      state.ant_orientation = static_cast<simulation::orientation::value_type>(simulation::orientation::NORTH + (std::rand() % 4));
+      state.last_step_res = simulation::step_result::NIL;
+
+      std::vector<u8> shades(256);
+      for (u32 i = 0; i < shades.size(); ++i)
+        shades[i] = u8(i);
+      if (!cyclic) {
+        for (u32 i = u32(shades.size()) - 1; i > 0; --i)
+          std::swap(shades[i], shades[u32(std::rand()) % (i + 1)]);
+      }
+      shades.resize(num_rules);
+
+      simulation::turn_direction::value_type const turns[] {
+        simulation::turn_direction::LEFT,
+        simulation::turn_direction::RIGHT,
+        simulation::turn_direction::LEFT,
+        simulation::turn_direction::RIGHT,
+        simulation::turn_direction::NO_CHANGE,
+      };
+      for (u32 i = 0; i < num_rules; ++i) {
+        state.rules[shades[i]] = { shades[(i + 1) % num_rules], turns[u32(std::rand()) % lengthof(turns)] };
+      }
+
+      [[maybe_unused]] b8 const allocated = simulation::allocate_grid(state, layout);
+      assert(allocated);
+      for (i32 row = 0; row < grid_height; ++row)
+        for (i32 col = 0; col < grid_width; ++col)
+          state.set_cell(u64((i64(row) * state.grid_stride()) + col), shades[u32(std::rand()) % num_rules]);
+
+      return state;
+    };
+
+    struct scenario
+    {
+      i32 grid_width;
+      i32 grid_height;
+      u32 num_rules;
+      b8 cyclic;
+      u64 num_gens;
+      u64 chunk_size;
+      simulation::grid_layout layout;
+    };
+
+    auto const DENSE = simulation::grid_layout::DENSE;
+    auto const BORDERED = simulation::grid_layout::BORDERED;
+    auto const PACKED = simulation::grid_layout::PACKED;
+    auto const TILED = simulation::grid_layout::TILED;
+    auto const SPARSE = simulation::grid_layout::SPARSE;
+
+    scenario const scenarios[] {
+      { 64,  48,   2,  true, 100'000,   1'000, DENSE },
+      { 64,  48,   5,  true, 100'000,       7, DENSE },
+      { 64,  48,   5, false, 100'000,   1'000, DENSE },
+      { 33,  17,  16,  true, 100'000, 100'000, DENSE },
+      { 33,  17,  16, false, 100'000,      64, DENSE },
+      { 1,    1,   3,  true,      10,       1, DENSE },
+      { 200,  3, 256,  true, 100'000,     333, DENSE },
+      { 256, 96, 200, false, 100'000,   5'000, DENSE },
+      { 500, 500,  2,  true, 2'000'000, 65'536, DENSE }, // long bursts far from the edge
+      { 64,  48,   2,  true, 100'000,   1'000, BORDERED },
+      { 33,  17,  16, false, 100'000,      64, BORDERED },
+      { 1,    1,   3,  true,      10,       1, BORDERED },
+      { 200,  3, 255,  true, 100'000,  10'000, BORDERED },
+      { 256, 96, 256, false, 100'000,   5'000, BORDERED }, // no spare shade for the border
+      { 64,  48,   2,  true, 100'000,   1'000, PACKED },
+      { 61,  47,   3,  true, 100'000,      77, PACKED }, // rows don't end on a byte
+      { 33,  17,   4, false, 100'000,   1'000, PACKED },
+      { 33,  17,  16,  true, 100'000,      64, PACKED },
+      { 1,    1,   3,  true,      10,       1, PACKED },
+      { 500, 500,  5,  true, 2'000'000, 65'536, PACKED },
+      { 64,  48,  17,  true, 100'000,   1'000, PACKED }, // too many shades to pack
+      { 64,  64,   2,  true, 100'000,   1'000, TILED },
+      { 200, 130,  5,  true, 100'000,      77, TILED }, // partial tiles on the right and bottom
+      { 130, 70,  16, false, 100'000,   1'000, TILED },
+      { 1,    1,   3,  true,      10,       1, TILED },
+      { 500, 500,  2,  true, 2'000'000, 65'536, TILED },
+      { 200, 130,  5,  true, 100'000,      77, SPARSE },
+      { 1,    1,   3,  true,      10,       1, SPARSE },
+    };
+
+    u32 seed = 1;
+    for (auto const &sc : scenarios) {
+      // the reference always steps through a dense grid
+      auto reference = make_random_state(sc.grid_width, sc.grid_height, sc.num_rules, sc.cyclic, seed, DENSE);
+      auto actual = make_random_state(sc.grid_width, sc.grid_height, sc.num_rules, sc.cyclic, seed, sc.layout);
+      assert_step_forward_equivalent(reference, actual, sc.num_gens, sc.chunk_size, nullptr, nullptr);
+
+      // small enough for plenty of slots to get overwritten
+      simulation::memo_table memo(64 * 1024);
+      assert_step_forward_equivalent(reference, actual, sc.num_gens, sc.chunk_size, &memo, nullptr);
+
+      simulation::highway_tracker highways;
+      assert_step_forward_equivalent(reference, actual, sc.num_gens, sc.chunk_size, nullptr, &highways);
+
+      assert_step_forward_equivalent(reference, actual, sc.num_gens, sc.chunk_size, nullptr, nullptr, true);
+
+      simulation::free_grid(reference);
+      simulation::free_grid(actual);
+      ++seed;
+    }
+
+    // lockstep, with more states than lanes and some reaching the edge first, finished
+    // off by step_forward which takes the pending step off the edge
+    for (u32 const num_lanes : { 1u, 3u, 8u }) {
+      std::vector<simulation::state> references, actuals;
+      std::vector<u64> num_gens;
+      for (auto const &sc : scenarios) {
+        references.push_back(make_random_state(sc.grid_width, sc.grid_height, sc.num_rules, sc.cyclic, seed, DENSE));
+        actuals.push_back(make_random_state(sc.grid_width, sc.grid_height, sc.num_rules, sc.cyclic, seed, sc.layout));
+        num_gens.push_back(sc.num_gens);
+        ++seed;
+      }
+      num_gens[1] = 0;
+      num_gens[2] = 12'345;
+
+      std::vector<simulation::state *> states;
+      for (auto &actual : actuals)
+        states.push_back(&actual);
+      simulation::step_forward_lockstep(states, num_gens, num_lanes);
+
+      for (u64 i = 0; i < actuals.size(); ++i) {
+        auto &reference = references[i];
+        auto &actual = actuals[i];
+
+        for (u64 g = 0; g < num_gens[i]; ++g) {
+          reference.last_step_res = simulation::attempt_step_forward(reference);
+          if (reference.last_step_res != simulation::step_result::SUCCESS)
+            break;
+          ++reference.generation;
+        }
+
+        simulation::step_forward(actual, simulation::select_step_kernel(actual), num_gens[i] - actual.generation);
+
+        ntest::assert_uint64(reference.generation, actual.generation);
+        ntest::assert_int8(reference.last_step_res, actual.last_step_res);
+        ntest::assert_int32(reference.ant_col, actual.ant_col);
+        ntest::assert_int32(reference.ant_row, actual.ant_row);
+        ntest::assert_int8(reference.ant_orientation, actual.ant_orientation);
+        ntest::assert_stdvec(grid_cells(reference), grid_cells(actual));
+
+        simulation::free_grid(reference);
+        simulation::free_grid(actual);
+      }
+    }
+
+    // memo engine on ants which build regular structures,
+    // so excursions get recalled and windows get timed
+    {
+      auto const assert_memoized_equivalent = [&](
+        i32 const grid_dim,
+        std::vector<simulation::turn_direction::value_type> const &turns,
+        u64 const num_gens,
+        std::source_location const loc = std::source_location::current())
+      {
+        auto reference = make_random_state(grid_dim, grid_dim, 2, true, 0, DENSE);
+        auto actual = make_random_state(grid_dim, grid_dim, 2, true, 0, DENSE);
+        for (auto *const state : { &reference, &actual }) {
+          state->rules = {};
+          for (u32 shade = 0; shade < turns.size(); ++shade)
+            state->rules[shade] = { u8((shade + 1) % turns.size()), turns[shade] };
+          std::fill_n(state->grid, state->num_pixels(), u8(0));
+        }
+
+        simulation::memo_table memo(1024 * 1024);
+        assert_step_forward_equivalent(reference, actual, num_gens, 99'999, &memo, nullptr, false, loc);
+
+        simulation::free_grid(reference);
+        simulation::free_grid(actual);
+        return memo.stats;
+      };
+
+      using simulation::turn_direction::LEFT;
+      using simulation::turn_direction::RIGHT;
+
+      // Langton's ant builds its highway after ~10'000 generations
+      auto const langton = assert_memoized_equivalent(2048, { LEFT, RIGHT }, 1'000'000);
+      ntest::assert_bool(true, langton.hits > langton.lookups / 2);
+
+      // runs long enough to time a window and step part of a kernel burst
+      auto const llrr = assert_memoized_equivalent(1000, { LEFT, LEFT, RIGHT, RIGHT }, 3'000'000);
+      ntest::assert_bool(true, llrr.kernel_steps > 0);
+    }
+
+    // fast-forwarding Langton's ant along its highway, which has a period of 104
+    // generations and heads 2 cells diagonally each time, up to the edge or
+    // partway along
+    {
+      auto const assert_fast_forward_equivalent = [&](
+        simulation::grid_layout const layout,
+        b8 const memoized,
+        b8 const windowed,
+        u64 const num_gens,
+        u8 const fill,
+        std::source_location const loc = std::source_location::current())
+      {
+        auto reference = make_random_state(4096, 4096, 2, true, 0, DENSE);
+        auto actual = make_random_state(4096, 4096, 2, true, 0, layout);
+        for (auto *const state : { &reference, &actual }) {
+          state->rules = {};
+          state->rules[0] = { 1, simulation::turn_direction::RIGHT };
+          state->rules[1] = { 0, simulation::turn_direction::LEFT };
+          simulation::fill_grid(*state, fill);
+        }
+
+        simulation::memo_table memo(1024 * 1024);
+        simulation::highway_tracker highways;
+        assert_step_forward_equivalent(reference, actual, num_gens, 1'000'003, memoized ? &memo : nullptr, &highways, windowed, loc);
+        // the highway is detected after 2^16 generations, and from there the
+        // edge is ~50'000 generations away
+        ntest::assert_uint32(104, highways.period, loc);
+        ntest::assert_bool(true, highways.gens_fast_forwarded > 10'000, loc);
+        if (layout == SPARSE) {
+          // a diagonal strip of chunks out of 4096
+          ntest::assert_bool(true, actual.sparse->committed.size() < 256, loc);
+        }
+
+        simulation::free_grid(reference);
+        simulation::free_grid(actual);
+      };
+
+      assert_fast_forward_equivalent(DENSE, false, false, UINT64_MAX, 0);
+      assert_fast_forward_equivalent(DENSE, false, false, 100'001, 0);
+      assert_fast_forward_equivalent(BORDERED, false, false, UINT64_MAX, 0);
+      assert_fast_forward_equivalent(PACKED, false, false, UINT64_MAX, 0);
+      assert_fast_forward_equivalent(PACKED, true, false, 100'001, 0);
+      assert_fast_forward_equivalent(TILED, true, false, UINT64_MAX, 0);
+      assert_fast_forward_equivalent(SPARSE, false, false, UINT64_MAX, 0);
+      assert_fast_forward_equivalent(SPARSE, true, false, 100'001, 0);
+      assert_fast_forward_equivalent(DENSE, true, false, UINT64_MAX, 0);
+      // mirrored, on remapped shades
+      assert_fast_forward_equivalent(DENSE, false, false, UINT64_MAX, 1);
+      assert_fast_forward_equivalent(PACKED, true, false, 100'001, 1);
+      assert_fast_forward_equivalent(TILED, true, false, UINT64_MAX, 1);
+      // stepping within windows, which move along with the ant
+      assert_fast_forward_equivalent(DENSE, false, true, UINT64_MAX, 0);
+      assert_fast_forward_equivalent(SPARSE, false, true, 100'001, 0);
+      assert_fast_forward_equivalent(PACKED, false, true, UINT64_MAX, 1);
+    }
+
+    // mapped grids are filled without touching a single page
+    {
+      auto state = make_random_state(1000, 1000, 3, true, 0, DENSE);
+      ntest::assert_bool(true, state.grid_resident_bytes() >= state.grid_bytes());
+
+      simulation::fill_grid(state, 2);
+      ntest::assert_uint8(2, state.shade_remap);
+      ntest::assert_uint64(0, state.grid_resident_bytes());
+      ntest::assert_uint8(2, state.get_cell(0));
+      ntest::assert_uint8(2, state.get_cell(state.num_pixels() - 1));
+
+      state.set_cell(500'500, 1);
+      ntest::assert_uint8(1, state.get_cell(500'500));
+      ntest::assert_uint8(2, state.get_cell(500'501));
+      ntest::assert_bool(true, state.grid_resident_bytes() > 0);
+      // a few pages at most, read ones included
+      ntest::assert_bool(true, state.grid_resident_bytes() < state.grid_bytes() / 16);
+
+      simulation::free_grid(state);
+    }
+
+    // huge pages are asked for, but whatever's given has to work the same
+    for (auto const pages : { simulation::huge_pages::OFF, simulation::huge_pages::THP, simulation::huge_pages::HUGETLB }) {
+      auto state = make_random_state(3000, 1000, 2, true, 0, DENSE);
+      simulation::free_grid(state);
+
+      ntest::assert_bool(true, simulation::allocate_grid(state, DENSE, pages));
+      ntest::assert_bool(true, state.grid_pages <= pages);
+      simulation::fill_grid(state, 1);
+      state.set_cell(1'234'567, 0);
+      ntest::assert_uint8(0, state.get_cell(1'234'567));
+      ntest::assert_uint8(1, state.get_cell(state.num_pixels() - 1));
+
+      simulation::free_grid(state);
+    }
+
+    // sparse chunks which go back to the fill shade get released
+    {
+      auto state = make_random_state(130, 70, 2, true, 0, SPARSE);
+      ntest::assert_uint64(6, state.sparse->committed.size());
+
+      for (u64 idx = 0; idx < state.num_pixels(); ++idx)
+        state.set_cell(idx, 0);
+      state.set_cell(u64((65 * state.grid_stride()) + 100), 1);
+
+      ntest::assert_uint64(5, simulation::release_uniform_chunks(state));
+      ntest::assert_uint64(1, state.sparse->committed.size());
+      ntest::assert_uint8(1, state.get_cell(u64((65 * state.grid_stride()) + 100)));
+      ntest::assert_uint8(0, state.get_cell(u64((65 * state.grid_stride()) + 99)));
+      ntest::assert_uint8(0, state.get_cell(0));
+
+      simulation::free_grid(state);
+    }
+
+    // a grid grows around the held back step off its edge
+    {
+      auto state = make_random_state(8, 8, 2, true, 0, DENSE);
+      state.ant_col = 7;
+      state.ant_row = 3;
+      state.ant_orientation = simulation::orientation::EAST;
+      state.generation = 10;
+      state.background_shade = 1;
+      u8 const corner = state.get_cell(0);
+
+      ntest::assert_bool(false, simulation::grow_grid(state, 8));
+      ntest::assert_int32(8, state.grid_width);
+
+      ntest::assert_bool(true, simulation::grow_grid(state, 12));
+      ntest::assert_int32(12, state.grid_width);
+      ntest::assert_int32(12, state.grid_height);
+      ntest::assert_int32(2, state.origin_col);
+      ntest::assert_int32(2, state.origin_row);
+      ntest::assert_int32(10, state.ant_col);
+      ntest::assert_int32(5, state.ant_row);
+      ntest::assert_uint64(11, state.generation);
+      ntest::assert_uint8(corner, state.get_cell(u64((2 * state.grid_stride()) + 2)));
+      ntest::assert_uint8(1, state.get_cell(0));
+      ntest::assert_uint8(1, state.get_cell(state.num_pixels() - 1));
+
+      simulation::free_grid(state);
+    }
+
+    // growth capped to a single cell goes on the side stepped off
+    for (auto const orientation : { simulation::orientation::WEST, simulation::orientation::NORTH }) {
+      auto state = make_random_state(5, 5, 2, true, 0, DENSE);
+      b8 const west = orientation == simulation::orientation::WEST;
+      state.ant_col = west ? 0 : 2;
+      state.ant_row = west ? 2 : 0;
+      state.ant_orientation = orientation;
+      state.background_shade = 1;
+      u8 const corner = state.get_cell(0);
+
+      ntest::assert_bool(true, simulation::grow_grid(state, 6));
+      ntest::assert_int32(6, state.grid_width);
+      ntest::assert_int32(6, state.grid_height);
+      ntest::assert_int32(west ? 1 : 0, state.origin_col);
+      ntest::assert_int32(west ? 0 : 1, state.origin_row);
+      ntest::assert_int32(west ? 0 : 2, state.ant_col);
+      ntest::assert_int32(west ? 2 : 0, state.ant_row);
+      ntest::assert_uint8(corner, state.get_cell(west ? 1 : u64(state.grid_stride())));
+      ntest::assert_uint8(1, state.get_cell(0));
+
+      simulation::free_grid(state);
+    }
+
+    // growing grids end up as if the ant had started out on the grown grid,
+    // where the original one ended up
+    {
+      auto const assert_grown_equivalent = [&](
+        simulation::grid_layout const layout,
+        std::vector<simulation::turn_direction::value_type> const &turns,
+        u64 const num_gens,
+        b8 const windowed,
+        std::source_location const loc = std::source_location::current())
+      {
+        auto actual = make_random_state(20, 12, 2, true, 0, layout);
+        actual.rules = {};
+        for (u32 shade = 0; shade < turns.size(); ++shade)
+          actual.rules[shade] = { u8((shade + 1) % turns.size()), turns[shade] };
+        // packed cells have to fit the new rules
+        simulation::free_grid(actual);
+        simulation::allocate_grid(actual, layout);
+        simulation::fill_grid(actual, 1);
+        actual.background_shade = 1;
+        i32 const start_col = actual.ant_col;
+        i32 const start_row = actual.ant_row;
+        auto const start_orientation = actual.ant_orientation;
+
+        auto const select_kernel = [windowed](simulation::state const &state) {
+          return windowed ? simulation::select_window_kernel(state) : simulation::select_step_kernel(state);
+        };
+        auto kernel = select_kernel(actual);
+        for (u64 remaining = num_gens; remaining > 0;) {
+          u64 const completed = simulation::step_forward(actual, kernel, remaining);
+          if (completed == remaining)
+            break;
+          if (!simulation::grow_grid(actual, 500))
+            break;
+          kernel = select_kernel(actual);
+          remaining -= completed + 1;
+        }
+        ntest::assert_bool(true, actual.grid_width > 20, loc);
+
+        auto reference = make_random_state(actual.grid_width, actual.grid_height, 2, true, 0, DENSE);
+        reference.rules = actual.rules;
+        simulation::fill_grid(reference, 1);
+        reference.ant_col = actual.origin_col + start_col;
+        reference.ant_row = actual.origin_row + start_row;
+        reference.ant_orientation = start_orientation;
+        for (u64 i = 0; i < num_gens; ++i) {
+          reference.last_step_res = simulation::attempt_step_forward(reference);
+          if (reference.last_step_res != simulation::step_result::SUCCESS)
+            break;
+          ++reference.generation;
+        }
+
+        ntest::assert_uint64(reference.generation, actual.generation, loc);
+        ntest::assert_int8(reference.last_step_res, actual.last_step_res, loc);
+        ntest::assert_int32(reference.ant_col, actual.ant_col, loc);
+        ntest::assert_int32(reference.ant_row, actual.ant_row, loc);
+        ntest::assert_int8(reference.ant_orientation, actual.ant_orientation, loc);
+        ntest::assert_stdvec(grid_cells(reference), grid_cells(actual), loc);
+
+        simulation::free_grid(reference);
+        simulation::free_grid(actual);
+      };
+
+      using simulation::turn_direction::LEFT;
+      using simulation::turn_direction::RIGHT;
+
+      // a blob which grows every which way
+      for (auto const layout : { DENSE, BORDERED, PACKED, TILED, SPARSE })
+        assert_grown_equivalent(layout, { LEFT, LEFT, RIGHT, RIGHT }, 300'000, false);
+      assert_grown_equivalent(TILED, { LEFT, LEFT, RIGHT, RIGHT }, 300'000, true);
+      // a highway, which runs into the largest grid allowed
+      assert_grown_equivalent(DENSE, { RIGHT, LEFT }, 100'000, false);
+      assert_grown_equivalent(SPARSE, { RIGHT, LEFT }, 100'000, true);
+    }
+
+    // a torus wraps around instead of stopping, on random grids and rulesets
+    {
+      struct torus_scenario
+      {
+        i32 grid_width;
+        i32 grid_height;
+        u32 num_rules;
+        b8 cyclic;
+        char const *kernel_name;
+      };
+
+      torus_scenario const torus_scenarios[] {
+        { 64,  64,  2,  true,  "torus,cyclic2,N" },
+        { 128, 16,  3,  true,  "torus,cyclic4" },
+        { 16,  256, 9,  false, "torus,table256" },
+        { 1,   32,  2,  false, "torus,table256" },
+        { 256, 128, 40, false, "torus,table256" },
+      };
+
+      u32 torus_seed = 1000;
+      for (auto const &sc : torus_scenarios) {
+        auto reference = make_random_state(sc.grid_width, sc.grid_height, sc.num_rules, sc.cyclic, torus_seed, DENSE);
+        auto actual = make_random_state(sc.grid_width, sc.grid_height, sc.num_rules, sc.cyclic, torus_seed, DENSE);
+        reference.boundary = simulation::grid_boundary::TORUS;
+        actual.boundary = simulation::grid_boundary::TORUS;
+        ++torus_seed;
+
+        ntest::assert_cstr(sc.kernel_name, simulation::select_step_kernel(actual).name);
+        assert_step_forward_equivalent(reference, actual, 300'000, 77'777, nullptr, nullptr);
+
+        simulation::free_grid(reference);
+        simulation::free_grid(actual);
+      }
+    }
+
+    // kernel selection
+    {
+      auto const assert_kernel = [&](
+        char const *const expected_name,
+        i32 const grid_width,
+        simulation::rules_t const &rules,
+        simulation::grid_layout const layout = simulation::grid_layout::DENSE,
+        std::source_location const loc = std::source_location::current())
+      {
+        simulation::state state = make_random_state(grid_width, 8, 2, true, 0, DENSE);
+        simulation::free_grid(state);
+        state.rules = rules;
+        // reallocate so a border gets a shade free under `rules`
+        [[maybe_unused]] b8 const allocated = simulation::allocate_grid(state, layout);
+        assert(allocated);
+        ntest::assert_cstr(expected_name, simulation::select_step_kernel(state).name, ntest::default_str_opts(), loc);
+        simulation::free_grid(state);
+      };
+
+      using simulation::turn_direction::LEFT;
+      using simulation::turn_direction::RIGHT;
+      using simulation::turn_direction::NO_CHANGE;
+
+      assert_kernel("cyclic2,pow2", 64, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 0, LEFT } } }));
+      assert_kernel("cyclic2", 63, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 0, LEFT } } }));
+      assert_kernel("cyclic4,N", 63, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 2, NO_CHANGE } }, { 2, { 0, LEFT } } }));
+      assert_kernel("table4", 63, generate_rules({ { 0, { 2, RIGHT } }, { 2, { 1, LEFT } }, { 1, { 0, LEFT } } }));
+      assert_kernel("table16,pow2", 32, generate_rules({ { 0, { 9, RIGHT } }, { 9, { 0, LEFT } } }));
+      assert_kernel("table256", 63, generate_rules({ { 0, { 200, RIGHT } }, { 200, { 0, LEFT } } }));
+      assert_kernel("sentinel2", 64, generate_rules({ { 0, { 0, RIGHT } } }), BORDERED);
+      assert_kernel("sentinel4", 63, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 0, LEFT } } }), BORDERED);
+      assert_kernel("sentinel256", 63, generate_rules({ { 0, { 200, RIGHT } }, { 200, { 0, LEFT } } }), BORDERED);
+      assert_kernel("cyclic2,pow2,packed1", 64, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 0, LEFT } } }), PACKED);
+      assert_kernel("cyclic4,N,packed2", 63, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 2, NO_CHANGE } }, { 2, { 0, LEFT } } }), PACKED);
+      assert_kernel("table16,packed4", 63, generate_rules({ { 0, { 9, RIGHT } }, { 9, { 0, LEFT } } }), PACKED);
+      assert_kernel("table256", 63, generate_rules({ { 0, { 200, RIGHT } }, { 200, { 0, LEFT } } }), PACKED);
+      assert_kernel("cyclic2,tiled", 64, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 0, LEFT } } }), TILED);
+      assert_kernel("table256,tiled", 63, generate_rules({ { 0, { 200, RIGHT } }, { 200, { 0, LEFT } } }), TILED);
+      assert_kernel("cyclic4,N,sparse", 64, generate_rules({ { 0, { 1, RIGHT } }, { 1, { 2, NO_CHANGE } }, { 2, { 0, LEFT } } }), SPARSE);
+
+      // window kernels step within a dense window, at most 256 cells across
+      for (auto const &[expected_name, grid_width, layout] : {
+        std::tuple{ "window,cyclic2,pow2", 1000, TILED },
+        std::tuple{ "window,cyclic2", 63, PACKED },
+      }) {
+        simulation::state state = make_random_state(grid_width, 8, 2, true, 0, layout);
+        ntest::assert_cstr(expected_name, simulation::select_window_kernel(state).name);
+        simulation::free_grid(state);
+      }
+    }
+  }
+  #endif // simulation::step_forward
+
   #if 1 // po::parse_simulate_one_options
   {
     auto const assert_parse = [](
@@ -510,6 +1790,17 @@ i32 main()
         ntest::assert_stdvec(expected_options.sim.save_points, actual_options.sim.save_points, loc);
         ntest::assert_uint64(expected_options.sim.generation_limit, actual_options.sim.generation_limit, loc);
         ntest::assert_uint8((u8)expected_options.sim.image_format, (u8)actual_options.sim.image_format, loc);
+        ntest::assert_uint8((u8)expected_options.sim.grid_layout, (u8)actual_options.sim.grid_layout, loc);
+        ntest::assert_uint8((u8)expected_options.sim.huge_pages, (u8)actual_options.sim.huge_pages, loc);
+        ntest::assert_uint8((u8)expected_options.sim.engine.engine, (u8)actual_options.sim.engine.engine, loc);
+        ntest::assert_uint64(expected_options.sim.engine.memo_table_bytes, actual_options.sim.engine.memo_table_bytes, loc);
+        ntest::assert_bool(expected_options.sim.engine.fast_forward_highways, actual_options.sim.engine.fast_forward_highways, loc);
+        ntest::assert_int32(expected_options.sim.engine.max_grid_dim, actual_options.sim.engine.max_grid_dim, loc);
+        ntest::assert_bool(expected_options.sim.engine.live_grid_file, actual_options.sim.engine.live_grid_file, loc);
+        ntest::assert_uint64(expected_options.sim.engine.keyframe_interval, actual_options.sim.engine.keyframe_interval, loc);
+        ntest::assert_bool(expected_options.sim.engine.checkpoint_saves, actual_options.sim.engine.checkpoint_saves, loc);
+        ntest::assert_uint64(expected_options.sim.save_threads, actual_options.sim.save_threads, loc);
+        ntest::assert_uint64(expected_options.sim.save_buffer_bytes, actual_options.sim.save_buffer_bytes, loc);
         ntest::assert_bool(expected_options.sim.save_final_state, actual_options.sim.save_final_state, loc);
         ntest::assert_bool(expected_options.sim.create_logs, actual_options.sim.create_logs, loc);
         ntest::assert_bool(expected_options.sim.save_image_only, actual_options.sim.save_image_only, loc);
@@ -579,13 +1870,27 @@ i32 main()
         "-S", "testing/valid_dir/valid_regular_file",
         "-g", "0",
         "-f", "unknown",
+        "-G", "unknown",
+        "-P", "unknown",
+        "-E", "unknown",
+        "-M", "0",
+        "-D", "1048577",
+        "-K", "0",
+        "-R", "0",
         "-l",
         "-v", "10", // therefore -o is required
       };
 
       errors_t expected_errors {
         "-o [ --save_path ] required",
-        "-f [ --image_format ] must be one of raw|plain",
+        "-f [ --image_format ] must be one of raw|plain|compressed",
+        "-G [ --grid_layout ] must be one of dense|bordered|packed|tiled|sparse",
+        "-P [ --huge_pages ] must be one of off|thp|hugetlb",
+        "-E [ --engine ] must be one of kernel|memo|window",
+        "-M [ --memo_table_mib ] must be > 0",
+        "-D [ --grow_to ] must be in range [1, 1048576]",
+        "-K [ --save_buffer_mib ] must be > 0",
+        "-R [ --delta_saves ] must be > 0",
       };
 
       assert_parse(lengthof(argv), argv, {}, expected_errors);
@@ -640,6 +1945,11 @@ i32 main()
           0, // generation_limit
           0, // save_interval
           pgm8::format::RAW, // image_format
+          simulation::grid_layout::DENSE, // grid_layout
+          simulation::huge_pages::OFF, // huge_pages
+          {}, // engine
+          0, // save_threads
+          u64(256) * 1024 * 1024, // save_buffer_bytes
           false, // save_final_state
           false, // create_logs
           false, // save_image_only
@@ -677,6 +1987,11 @@ i32 main()
           0, // generation_limit
           10, // save_interval
           pgm8::format::RAW, // image_format
+          simulation::grid_layout::DENSE, // grid_layout
+          simulation::huge_pages::OFF, // huge_pages
+          {}, // engine
+          0, // save_threads
+          u64(256) * 1024 * 1024, // save_buffer_bytes
           true, // save_final_state
           true, // create_logs
           true, // save_image_only
@@ -699,6 +2014,17 @@ i32 main()
         "-g", "1000",
         "-v", "42",
         "-f", "plain",
+        "-G", "bordered",
+        "-P", "thp",
+        "-E", "memo",
+        "-M", "16",
+        "-H",
+        "-D", "4096",
+        "-W", "2",
+        "-K", "64",
+        "-F",
+        "-R", "5",
+        "-c",
       };
 
       po::simulate_one_options const expected_options {
@@ -711,6 +2037,47 @@ i32 main()
           1000, // generation_limit
           42, // save_interval
           pgm8::format::PLAIN, // image_format
+          simulation::grid_layout::BORDERED, // grid_layout
+          simulation::huge_pages::THP, // huge_pages
+          { simulation::step_engine::MEMO, 16 * 1024 * 1024, true, 4096, true, 5, true }, // engine
+          2, // save_threads
+          u64(64) * 1024 * 1024, // save_buffer_bytes
+          false, // save_final_state
+          false, // create_logs
+          false, // save_image_only
+        },
+      };
+
+      errors_t expected_errors{};
+
+      assert_parse(lengthof(argv), argv, expected_options, expected_errors);
+    }
+
+    {
+      // compressed images are written on a save thread unless told otherwise
+      char const *const argv[] {
+        "simulate_one",
+        "-S", "testing/valid_dir/valid_regular_file",
+        "-g", "0",
+        "-o", "testing/valid_dir",
+        "-f", "compressed",
+      };
+
+      po::simulate_one_options const expected_options {
+        "", // name
+        "testing/valid_dir/valid_regular_file", // state_file_path
+        "", // log_file_path
+        {
+          "testing/valid_dir", // save_path
+          {}, // save_points
+          0, // generation_limit
+          0, // save_interval
+          pgm8::format::COMPRESSED, // image_format
+          simulation::grid_layout::DENSE, // grid_layout
+          simulation::huge_pages::OFF, // huge_pages
+          {}, // engine
+          1, // save_threads
+          u64(256) * 1024 * 1024, // save_buffer_bytes
           false, // save_final_state
           false, // create_logs
           false, // save_image_only
@@ -751,11 +2118,25 @@ i32 main()
         ntest::assert_stdstr(expected_options.state_dir_path, actual_options.state_dir_path, str_opts, loc);
         ntest::assert_stdstr(expected_options.log_file_path, actual_options.log_file_path, str_opts, loc);
         ntest::assert_uint64(expected_options.num_threads, actual_options.num_threads, loc);
+        ntest::assert_uint64(expected_options.queue_size, actual_options.queue_size, loc);
+        ntest::assert_uint64(expected_options.batch_size, actual_options.batch_size, loc);
+        ntest::assert_uint64(expected_options.interleave, actual_options.interleave, loc);
 
         ntest::assert_stdstr(expected_options.sim.save_path, actual_options.sim.save_path, str_opts, loc);
         ntest::assert_stdvec(expected_options.sim.save_points, actual_options.sim.save_points, loc);
         ntest::assert_uint64(expected_options.sim.generation_limit, actual_options.sim.generation_limit, loc);
         ntest::assert_uint8((u8)expected_options.sim.image_format, (u8)actual_options.sim.image_format, loc);
+        ntest::assert_uint8((u8)expected_options.sim.grid_layout, (u8)actual_options.sim.grid_layout, loc);
+        ntest::assert_uint8((u8)expected_options.sim.huge_pages, (u8)actual_options.sim.huge_pages, loc);
+        ntest::assert_uint8((u8)expected_options.sim.engine.engine, (u8)actual_options.sim.engine.engine, loc);
+        ntest::assert_uint64(expected_options.sim.engine.memo_table_bytes, actual_options.sim.engine.memo_table_bytes, loc);
+        ntest::assert_bool(expected_options.sim.engine.fast_forward_highways, actual_options.sim.engine.fast_forward_highways, loc);
+        ntest::assert_int32(expected_options.sim.engine.max_grid_dim, actual_options.sim.engine.max_grid_dim, loc);
+        ntest::assert_bool(expected_options.sim.engine.live_grid_file, actual_options.sim.engine.live_grid_file, loc);
+        ntest::assert_uint64(expected_options.sim.engine.keyframe_interval, actual_options.sim.engine.keyframe_interval, loc);
+        ntest::assert_bool(expected_options.sim.engine.checkpoint_saves, actual_options.sim.engine.checkpoint_saves, loc);
+        ntest::assert_uint64(expected_options.sim.save_threads, actual_options.sim.save_threads, loc);
+        ntest::assert_uint64(expected_options.sim.save_buffer_bytes, actual_options.sim.save_buffer_bytes, loc);
         ntest::assert_bool(expected_options.sim.save_final_state, actual_options.sim.save_final_state, loc);
         ntest::assert_bool(expected_options.sim.create_logs, actual_options.sim.create_logs, loc);
         ntest::assert_bool(expected_options.sim.save_image_only, actual_options.sim.save_image_only, loc);
@@ -825,12 +2206,20 @@ i32 main()
         "-S", "testing/valid_dir",
         "-g", "0",
         "-f", "unknown",
+        "-G", "unknown",
+        "-P", "unknown",
+        "-E", "unknown",
+        "-M", "0",
         "-v", "10", // therefore -o is required
       };
 
       errors_t expected_errors {
         "-o [ --save_path ] required",
-        "-f [ --image_format ] must be one of raw|plain",
+        "-f [ --image_format ] must be one of raw|plain|compressed",
+        "-G [ --grid_layout ] must be one of dense|bordered|packed|tiled|sparse",
+        "-P [ --huge_pages ] must be one of off|thp|hugetlb",
+        "-E [ --engine ] must be one of kernel|memo|window",
+        "-M [ --memo_table_mib ] must be > 0",
       };
 
       assert_parse(lengthof(argv), argv, {}, expected_errors);
@@ -856,6 +2245,8 @@ i32 main()
         "simulate_many",
         "-S", "testing/valid_dir",
         "-T", "0",
+        "-B", "0",
+        "-I", "9",
         "-g", "0",
         "-s", // therefore -o is required
         "-p", "1,2,3", // missing []
@@ -865,6 +2256,8 @@ i32 main()
         "-o [ --save_path ] required",
         "-p [ --save_points ] must be a JSON array",
         "-T [ --num_threads ] must be > 0",
+        "-I [ --interleave ] must be in range [1, 8]",
+        "-B [ --batch_size ] must be > 0",
       };
 
       assert_parse(lengthof(argv), argv, {}, expected_errors);
@@ -882,6 +2275,8 @@ i32 main()
         "", // log_file_path
         std::max(std::thread::hardware_concurrency(), u32(1)), // num_threads
         u16(50), // queue_size
+        u16(1), // batch_size
+        u8(8), // interleave
         false, // log_to_stdout
         {
           "", // save_path
@@ -889,6 +2284,11 @@ i32 main()
           0, // generation_limit
           0, // save_interval
           pgm8::format::RAW, // image_format
+          simulation::grid_layout::DENSE, // grid_layout
+          simulation::huge_pages::OFF, // huge_pages
+          {}, // engine
+          0, // save_threads
+          u64(256) * 1024 * 1024, // save_buffer_bytes
           false, // save_final_state
           false, // create_logs
           false, // save_image_only
@@ -905,6 +2305,8 @@ i32 main()
         "simulate_many",
         "-T", "42",
         "-Q", "13",
+        "-B", "8",
+        "-I", "3",
         "-S", "testing/valid_dir",
         "-L", "testing/valid_dir/log.txt",
         "-o", "testing/valid_dir",
@@ -923,6 +2325,8 @@ i32 main()
         "testing/valid_dir/log.txt", // log_file_path
         u32(42), // num_threads
         u16(13), // queue_size
+        u16(8), // batch_size
+        u8(3), // interleave
         true, // log_to_stdout
         {
           "testing/valid_dir", // save_path
@@ -930,6 +2334,11 @@ i32 main()
           0, // generation_limit
           10, // save_interval
           pgm8::format::RAW, // image_format
+          simulation::grid_layout::DENSE, // grid_layout
+          simulation::huge_pages::OFF, // huge_pages
+          {}, // engine
+          0, // save_threads
+          u64(256) * 1024 * 1024, // save_buffer_bytes
           true, // save_final_state
           true, // create_logs
           true, // save_image_only
@@ -952,6 +2361,17 @@ i32 main()
         "-g", "1000",
         "-v", "42",
         "-f", "plain",
+        "-G", "bordered",
+        "-P", "thp",
+        "-E", "memo",
+        "-M", "16",
+        "-H",
+        "-I", "4",
+        "-W", "2",
+        "-K", "64",
+        "-F",
+        "-R", "5",
+        "-c",
       };
 
       po::simulate_many_options const expected_options {
@@ -959,6 +2379,8 @@ i32 main()
         "testing/valid_dir/log.txt", // log_file_path
         u32(1), // num_threads
         u16(50), // queue_size
+        u16(4), // batch_size
+        u8(4), // interleave
         true, // log_to_stdout
         {
           "testing/valid_dir", // save_path
@@ -966,6 +2388,11 @@ i32 main()
           1000, // generation_limit
           42, // save_interval
           pgm8::format::PLAIN, // image_format
+          simulation::grid_layout::BORDERED, // grid_layout
+          simulation::huge_pages::THP, // huge_pages
+          { simulation::step_engine::MEMO, 16 * 1024 * 1024, true, 0, true, 5, true }, // engine
+          2, // save_threads
+          u64(64) * 1024 * 1024, // save_buffer_bytes
           false, // save_final_state
           false, // create_logs
           false, // save_image_only
@@ -1044,7 +2471,7 @@ i32 main()
       errors_t expected_errors {
         "failed to open -o [ --out_file_path ]",
         "-c [ --content ] must match /^(noise)|(fill=[0-9]{1,3})$/",
-        "-f [ --format ] must be one of raw|plain",
+        "-f [ --format ] must be one of raw|plain|compressed",
         "-w [ --width ] must be in range [1, 65535]",
         "-h [ --height ] must be in range [1, 65535]",
         "-m [ --maxval ] must be in range [1, 255]",
@@ -1187,11 +2614,11 @@ i32 main()
         "-o [ --out_dir_path ] does not exist, specify -c [ --create_dirs ] to create it",
         "-N [ --count ] must be > 0",
         "-O [ --ant_orientations ] must match /^[nNeEsSwW]+$/",
-        "-h [ --grid_height ] must be in range [1, 65535]",
+        "-h [ --grid_height ] must be in range [1, 1048576]",
         "-n [ --name_mode ] must match /^(turndirecs)|(randwords,[1-9])|(alpha,[1-9])$/",
         "-t [ --turn_directions ] must match /^[lLnNrR]+$/",
         "-s [ --shade_order ] must be one of asc|desc|rand",
-        "-w [ --grid_width ] must be in range [1, 65535]",
+        "-w [ --grid_width ] must be in range [1, 1048576]",
         "-M [ --max_num_rules ] must be in range [2, 256]",
         "-m [ --min_num_rules ] must be in range [2, 256]",
       };